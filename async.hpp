@@ -0,0 +1,121 @@
+#ifndef ASYNC_HPP_
+#define ASYNC_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+
+// Background APSP jobs
+// An APSPJob runs one of the engines on its own thread over a private copy
+// of the graph. The caller can poll progress, wait, or cancel; the engine
+// polls the job's stop token between sources (Johnson) or k iterations
+// (Floyd-Warshall), so a cancelled job stops within one unit of work and
+// hands back the rows it had finished. Destroying a job cancels it and
+// waits for the thread.
+
+enum class APSPAlgorithm {
+  johnson,
+  floydWarshall
+};
+
+struct APSPProgress {
+  // sources searched (Johnson) or k iterations done (Floyd-Warshall)
+  int completed = 0;
+  int total = 0;
+};
+
+template <typename T>
+struct APSPJobResult {
+  // V rows; a row is empty if the job was cancelled before it was final
+  std::vector<std::vector<T> > rows {};
+  bool negativeCycle = false;
+  bool cancelled = false;
+
+  // number of finished rows
+  int completedRows() const {
+    int count = 0;
+    for (const std::vector<T>& row : rows) {
+      count += !row.empty();
+    }
+    return count;
+  }
+};
+
+template <typename T>
+class APSPJob {
+ private:
+  Graph<T> graph;
+  APSPAlgorithm algorithm;
+  APSPOptions options;
+  std::atomic<int> completed {0};
+  std::promise<APSPJobResult<T> > promise {};
+  std::future<APSPJobResult<T> > future {promise.get_future()};
+  // last, so it is joined before anything it uses is destroyed
+  std::jthread worker {};
+
+  void run(std::stop_token stop) {
+    try {
+      APSPOptions jobOptions = options;
+      jobOptions.stopToken = stop;
+      jobOptions.progress = &completed;
+      APSPJobResult<T> result {};
+      if (algorithm == APSPAlgorithm::johnson) {
+        result.rows = johnsonAPSPWithOptions(graph, jobOptions);
+      } else {
+        result.rows = floydWarshallAPSPWithOptions(graph, jobOptions);
+      }
+      const int V = graph.size();
+      result.negativeCycle = V > 0 and result.rows.empty();
+      result.cancelled = !result.negativeCycle and result.completedRows() < V;
+      promise.set_value(std::move(result));
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+  }
+
+ public:
+  // starts the job; G is copied, so the caller may change it afterwards.
+  // options.stopToken and options.progress are replaced by the job's own
+  APSPJob(const Graph<T>& G, APSPAlgorithm algorithm,
+          const APSPOptions& options = APSPOptions {})
+      : graph {G}, algorithm {algorithm}, options {options},
+        worker {[this](std::stop_token stop) { run(stop); }} {}
+
+  APSPJob(const APSPJob&) = delete;
+  APSPJob& operator=(const APSPJob&) = delete;
+
+  APSPProgress progress() const {
+    return {completed.load(), graph.size()};
+  }
+
+  // asks the job to stop after its current unit of work
+  void cancel() {
+    worker.request_stop();
+  }
+
+  // true once the result is available, and after it has been taken
+  bool ready() const {
+    return !future.valid() or future.wait_for(std::chrono::seconds {0}) ==
+                                   std::future_status::ready;
+  }
+
+  // does nothing once the result has been taken
+  void wait() const {
+    if (future.valid()) {
+      future.wait();
+    }
+  }
+
+  // waits for the job and returns its result, rethrowing anything the
+  // engine threw; may be called once
+  APSPJobResult<T> get() {
+    return future.get();
+  }
+};
+
+#endif      // ASYNC_HPP_
@@ -0,0 +1,128 @@
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "graph.hpp"
+
+// APSP over many small graphs
+// Solving thousands of tiny graphs one johnsonAPSP call at a time pays
+// for thread start-up, CSR and scratch allocation per graph. batchAPSP
+// starts its workers once, hands out whole graphs as tasks, and gives
+// each worker one ScratchArena that every graph it solves reuses after a
+// reset, so after the first few graphs nothing but the results is
+// allocated. Graphs of at most kSmallGraphVertices vertices skip the CSR
+// altogether and go to a Floyd-Warshall over a fixed-size local matrix
+// whose rows have a compile-time length, so the compiler unrolls and
+// vectorises them, and the matrix, an N x N array on the stack, stays in
+// L1. Up to
+// kMediumGraphVertices the same kernel on a wider matrix still beats
+// Johnson, whose per-source setup dominates at that size.
+
+inline constexpr int kSmallGraphVertices = 16;
+inline constexpr int kMediumGraphVertices = 64;
+
+// Floyd-Warshall on a graph of at most N vertices; unused columns stay
+// at infinity and never change anything. Returns an empty matrix if G
+// has a negative weight cycle, as soon as one reaches the diagonal: a
+// negative cycle whose largest vertex is k makes dist[k][k] negative
+// before round k, and pivoting on it would let entries double in size
+// every round until an integer T overflows
+template <int N, typename T>
+std::vector<std::vector<T> > smallFloydWarshall(const Graph<T>& G) {
+  const int V = G.size();
+  if (V > N) {
+    throw std::invalid_argument("graph too large for smallFloydWarshall");
+  }
+  const T inf = infinity<T>();
+  T dist[N][N];
+  for (int i = 0; i < V; ++i) {
+    for (int j = 0; j < N; ++j) {
+      dist[i][j] = inf;
+    }
+  }
+  for (int i = 0; i < V; ++i) {
+    dist[i][i] = T {};
+    for (const auto& [j, weight] : G.neighbours(i)) {
+      dist[i][j] = std::min(dist[i][j], weight);
+    }
+  }
+  for (int k = 0; k < V; ++k) {
+    if (dist[k][k] < T {}) {
+      return {};
+    }
+    T rowK[N];
+    std::copy_n(dist[k], N, rowK);
+    for (int i = 0; i < V; ++i) {
+      T dik = dist[i][k];
+      // branch-free, so the j loop becomes a few vector min operations
+      for (int j = 0; j < N; ++j) {
+        T via = dik == inf or rowK[j] == inf ? inf : dik + rowK[j];
+        dist[i][j] = via < dist[i][j] ? via : dist[i][j];
+      }
+    }
+  }
+  std::vector<std::vector<T> > result(V);
+  for (int i = 0; i < V; ++i) {
+    result[i].assign(dist[i], dist[i] + V);
+  }
+  return result;
+}
+
+// all-pairs shortest paths of every graph, result[g] being what
+// johnsonAPSP(graphs[g]) returns (empty if it has a negative weight
+// cycle). Graphs are spread over options.numThreads workers and each is
+// solved by one of them; options.stopToken and options.progress are not
+// used
+template <typename T>
+std::vector<std::vector<std::vector<T> > >
+batchAPSP(std::span<const Graph<T> > graphs,
+          const APSPOptions& options = APSPOptions {}) {
+  const int count = static_cast<int>(graphs.size());
+  std::vector<std::vector<std::vector<T> > > results(count);
+  std::atomic<int> nextGraph {0};
+  std::mutex statsMutex {};
+  // tiny graphs are cheap, so workers take them a few at a time
+  constexpr int chunk = 8;
+  runWorkers(workerCount(options.numThreads, count), [&](unsigned) {
+    ScratchArena arena {0, options.resource};
+    APSPStats workerStats {};
+    APSPOptions graphOptions {};
+    graphOptions.resource = &arena;
+    graphOptions.numThreads = 1;
+    graphOptions.stats = &workerStats;
+    graphOptions.sourceBatch = options.sourceBatch;
+    for (int first = nextGraph.fetch_add(chunk); first < count;
+         first = nextGraph.fetch_add(chunk)) {
+      for (int g = first; g < std::min(count, first + chunk); ++g) {
+        const Graph<T>& G = graphs[g];
+        if (G.size() <= kSmallGraphVertices) {
+          results[g] = smallFloydWarshall<kSmallGraphVertices>(G);
+        } else if (G.size() <= kMediumGraphVertices) {
+          results[g] = smallFloydWarshall<kMediumGraphVertices>(G);
+        } else {
+          arena.reset();
+          results[g] = johnsonAPSPWithOptions(G, graphOptions);
+        }
+      }
+    }
+    if constexpr (kStatsEnabled) {
+      std::lock_guard<std::mutex> lock {statsMutex};
+      publishStats(options, workerStats);
+    }
+  });
+  return results;
+}
+
+template <typename T>
+std::vector<std::vector<std::vector<T> > >
+batchAPSP(const std::vector<Graph<T> >& graphs,
+          const APSPOptions& options = APSPOptions {}) {
+  return batchAPSP(std::span<const Graph<T> > {graphs}, options);
+}
+
+#endif      // BATCH_HPP_
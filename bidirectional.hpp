@@ -0,0 +1,194 @@
+#ifndef BIDIRECTIONAL_HPP_
+#define BIDIRECTIONAL_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+
+// Bidirectional Dijkstra for point-to-point queries
+// A forward search from s over the graph and a backward search from t
+// over its transpose take turns, each settling the vertex at the smaller
+// of the two queue fronts. Every edge relaxed into a vertex the other side
+// has reached gives a candidate path; once the two fronts add up to no
+// less than the best candidate, no shorter path remains and the search
+// stops. On road-like graphs the two balls meet long before either one
+// covers what a single search from s would.
+// Negative weights are handled the way Johnson's algorithm does: the
+// searches run on the graph reweighted by Bellman-Ford potentials, where
+// every weight is non-negative, and answers are converted back.
+
+// per-thread workspace for queries; clearing it between queries is O(1),
+// so a query only costs what it visits
+template <typename T>
+class BidirectionalSearch {
+ private:
+  struct Side {
+    std::vector<T> dist {};
+    std::vector<unsigned> stamp {};
+    std::vector<std::pair<T, int> > heap {};
+
+    explicit Side(int N) : dist(N), stamp(N, 0) {}
+  };
+
+  Side forward;
+  Side backward;
+  unsigned generation {};
+  int settledCount {};
+
+  template <typename>
+  friend class BidirectionalDijkstra;
+
+ public:
+  explicit BidirectionalSearch(int N) : forward {N}, backward {N} {}
+
+  // vertices settled by the last query, in both directions
+  int settled() const {
+    return settledCount;
+  }
+};
+
+template <typename T>
+class BidirectionalDijkstra {
+ private:
+  int numVertices {};
+  std::vector<T> potential {};
+  // G reweighted by the potentials, and its transpose, built once
+  CSRGraph<T> reweighted {0};
+  CSRGraph<T> reverse {0};
+
+  // reweights a CSR of G by h and caches its transpose
+  void prepare(std::pmr::vector<T>& h, const APSPOptions& options) {
+    reweightEdges(reweighted, h);
+    potential.assign(h.begin(), h.end());
+    reverse = transpose(reweighted, options.resource);
+  }
+
+  // reweighted distance d'(s, t) back to the original weights
+  T original(T d, int s, int t) const {
+    return d == infinity<T>() ? d : d - potential[s] + potential[t];
+  }
+
+  void checkVertex(int v) const {
+    if (v < 0 or v >= numVertices) {
+      throw std::out_of_range("invalid vertex number");
+    }
+  }
+
+ public:
+  // computes Johnson potentials for G; throws std::invalid_argument if G
+  // has a negative weight cycle
+  explicit BidirectionalDijkstra(const Graph<T>& G,
+                                 const APSPOptions& options = APSPOptions {})
+      : numVertices {G.size()}, reweighted {G, options.resource} {
+    std::pmr::vector<T> h(numVertices, T {}, options.resource);
+    if (!bellmanFordPotentials(reweighted, h)) {
+      throw std::invalid_argument("graph has a negative weight cycle");
+    }
+    prepare(h, options);
+  }
+
+  // reuses potentials from an earlier Johnson run, such as those the
+  // caller kept for G; they must leave every edge non-negative, which
+  // is not checked
+  BidirectionalDijkstra(const Graph<T>& G, const std::vector<T>& potentials,
+                        const APSPOptions& options = APSPOptions {})
+      : numVertices {G.size()}, reweighted {G, options.resource} {
+    if (static_cast<int>(potentials.size()) != numVertices) {
+      throw std::invalid_argument("need one potential per vertex");
+    }
+    std::pmr::vector<T> h(potentials.begin(), potentials.end(),
+                          options.resource);
+    prepare(h, options);
+  }
+
+  int size() const {
+    return numVertices;
+  }
+
+  // exact d(s, t)
+  T distance(int s, int t, BidirectionalSearch<T>& search) const {
+    checkVertex(s);
+    checkVertex(t);
+    using Side = typename BidirectionalSearch<T>::Side;
+    using Entry = std::pair<T, int>;
+    const T inf = infinity<T>();
+    search.settledCount = 0;
+    if (s == t) {
+      return T {};
+    }
+    if (++search.generation == 0) {
+      std::fill(search.forward.stamp.begin(), search.forward.stamp.end(), 0);
+      std::fill(search.backward.stamp.begin(), search.backward.stamp.end(),
+                0);
+      search.generation = 1;
+    }
+    const unsigned generation = search.generation;
+    auto distanceOf = [generation, inf](const Side& side, int v) {
+      return side.stamp[v] == generation ? side.dist[v] : inf;
+    };
+    auto reach = [generation](Side& side, int v, T d) {
+      side.stamp[v] = generation;
+      side.dist[v] = d;
+      side.heap.push_back({d, v});
+      std::push_heap(side.heap.begin(), side.heap.end(),
+                     std::greater<Entry> {});
+    };
+    // drops stale entries, so the front is the next vertex to settle
+    auto front = [inf](Side& side) {
+      while (!side.heap.empty() and
+             side.heap.front().first > side.dist[side.heap.front().second]) {
+        std::pop_heap(side.heap.begin(), side.heap.end(),
+                      std::greater<Entry> {});
+        side.heap.pop_back();
+      }
+      return side.heap.empty() ? inf : side.heap.front().first;
+    };
+    search.forward.heap.clear();
+    search.backward.heap.clear();
+    reach(search.forward, s, T {});
+    reach(search.backward, t, T {});
+    T best = inf;
+    while (true) {
+      T forwardKey = front(search.forward);
+      T backwardKey = front(search.backward);
+      // meeting-point rule: a shorter path would have to leave both
+      // queues, so it costs at least forwardKey + backwardKey
+      if (forwardKey == inf or backwardKey == inf or
+          (best != inf and forwardKey + backwardKey >= best)) {
+        break;
+      }
+      bool goForward = forwardKey <= backwardKey;
+      Side& side = goForward ? search.forward : search.backward;
+      const Side& other = goForward ? search.backward : search.forward;
+      const CSRGraph<T>& G = goForward ? reweighted : reverse;
+      std::pop_heap(side.heap.begin(), side.heap.end(),
+                    std::greater<Entry> {});
+      auto [du, u] = side.heap.back();
+      side.heap.pop_back();
+      ++search.settledCount;
+      for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+        int v = G.targets[e];
+        T viaU = du + G.weights[e];
+        if (viaU < distanceOf(side, v)) {
+          reach(side, v, viaU);
+          T beyond = distanceOf(other, v);
+          if (beyond != inf and viaU + beyond < best) {
+            best = viaU + beyond;
+          }
+        }
+      }
+    }
+    return original(best, s, t);
+  }
+
+  // exact d(s, t) with a workspace of its own, which costs O(V)
+  T distance(int s, int t) const {
+    BidirectionalSearch<T> search {numVertices};
+    return distance(s, t, search);
+  }
+};
+
+#endif      // BIDIRECTIONAL_HPP_
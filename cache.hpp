@@ -0,0 +1,264 @@
+#ifndef CACHE_HPP_
+#define CACHE_HPP_
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+#include "checkpoint.hpp"
+
+// APSP results cached by graph content
+// Entries are keyed by Graph::fingerprint(), which costs O(1), so asking
+// again for an unchanged graph returns the stored matrix without looking
+// at its edges. The in-memory entries are kept within a byte budget,
+// evicting the least recently used. With a directory, every result is
+// also written there as <fingerprint>.apsp and a result evicted from
+// memory, or computed by an earlier process, is read back from disk
+// instead of being recomputed. The directory is never pruned.
+//
+// A file is native-endian binary: a CheckpointHeader (algorithm 4, the
+// low half of the fingerprint as digest), the high half, the number of
+// rows (V, or 0 for a graph with a negative weight cycle) and the rows.
+// A file that does not match is ignored and overwritten. Each write
+// goes to a temporary file of its own in the directory and is renamed
+// into place, so threads or processes storing the same result at once
+// never see each other's partial files; a write that fails only leaves
+// the result uncached on disk.
+
+struct APSPCacheStats {
+  // served from memory, from disk, or computed
+  std::uint64_t hits {};
+  std::uint64_t diskHits {};
+  std::uint64_t misses {};
+  // entries dropped from memory to stay within the budget
+  std::uint64_t evictions {};
+  // results that could not be written to the directory
+  std::uint64_t diskWriteFailures {};
+};
+
+// thread-safe; two threads missing on the same graph at once both solve it
+template <typename T>
+class APSPCache {
+ public:
+  using Rows = std::vector<std::vector<T> >;
+
+ private:
+  struct FingerprintHash {
+    std::size_t operator()(const GraphFingerprint& key) const {
+      return static_cast<std::size_t>(key.low ^ mixBits(key.high));
+    }
+  };
+
+  struct Entry {
+    GraphFingerprint key {};
+    std::shared_ptr<const Rows> rows {};
+    std::size_t bytes {};
+  };
+
+  std::size_t budget {};
+  std::string directory {};
+  mutable std::mutex mutex {};
+  // most recently used first
+  std::list<Entry> recent {};
+  std::unordered_map<GraphFingerprint, typename std::list<Entry>::iterator,
+                     FingerprintHash>
+      index {};
+  std::size_t usedBytes {};
+  APSPCacheStats counters {};
+  // temporary file names are <fingerprint>.<tag>.<count>.tmp: the tag is
+  // random per cache, so other processes pick other names, and the count
+  // differs between writes of this cache
+  std::uint64_t tempTag {};
+  std::atomic<std::uint64_t> tempCount {0};
+
+  static std::size_t footprint(const Rows& rows) {
+    std::size_t bytes = sizeof(Entry) + rows.size() * sizeof(rows[0]);
+    for (const std::vector<T>& row : rows) {
+      bytes += row.size() * sizeof(T);
+    }
+    return bytes;
+  }
+
+  std::string pathOf(const GraphFingerprint& key) const {
+    char name[40] {};
+    std::snprintf(name, sizeof name, "%016llx%016llx.apsp",
+                  static_cast<unsigned long long>(key.high),
+                  static_cast<unsigned long long>(key.low));
+    return (std::filesystem::path {directory} / name).string();
+  }
+
+  // the stored rows, or nullptr if the file is missing or does not match
+  std::shared_ptr<const Rows> readFile(const GraphFingerprint& key,
+                                       int V) const {
+    std::ifstream in {pathOf(key), std::ios::binary};
+    if (!in) {
+      return nullptr;
+    }
+    CheckpointHeader header {};
+    CheckpointHeader expected = checkpointHeader<T>(4, V, key.low);
+    std::uint64_t high {};
+    std::int64_t numRows {};
+    if (!readBytes(in, &header, sizeof header) or
+        std::memcmp(&header, &expected, sizeof header) != 0 or
+        !readBytes(in, &high, sizeof high) or high != key.high or
+        !readBytes(in, &numRows, sizeof numRows) or
+        (numRows != 0 and numRows != V)) {
+      return nullptr;
+    }
+    auto rows = std::make_shared<Rows>(numRows);
+    for (std::vector<T>& row : *rows) {
+      row.resize(V);
+      if (!readBytes(in, row.data(), V * sizeof(T))) {
+        return nullptr;
+      }
+    }
+    return rows;
+  }
+
+  // stores rows at pathOf(key); false if that failed
+  bool writeFile(const GraphFingerprint& key, int V, const Rows& rows) {
+    CheckpointHeader header = checkpointHeader<T>(4, V, key.low);
+    std::int64_t numRows = static_cast<std::int64_t>(rows.size());
+    std::string path = pathOf(key);
+    std::string temporary = path + "." + std::to_string(tempTag) + "." +
+                            std::to_string(tempCount++) + ".tmp";
+    try {
+      replaceFile(path, [&](std::ostream& out) {
+        writeBytes(out, &header, sizeof header);
+        writeBytes(out, &key.high, sizeof key.high);
+        writeBytes(out, &numRows, sizeof numRows);
+        for (const std::vector<T>& row : rows) {
+          writeBytes(out, row.data(), row.size() * sizeof(T));
+        }
+      }, temporary);
+    } catch (const std::exception&) {
+      std::error_code ignored {};
+      std::filesystem::remove(temporary, ignored);
+      return false;
+    }
+    return true;
+  }
+
+  // makes rows the most recent entry for key; caller holds the mutex
+  void remember(const GraphFingerprint& key,
+                std::shared_ptr<const Rows> rows) {
+    std::size_t bytes = footprint(*rows);
+    if (bytes > budget or index.contains(key)) {
+      return;
+    }
+    recent.push_front({key, std::move(rows), bytes});
+    index.emplace(key, recent.begin());
+    usedBytes += bytes;
+    while (usedBytes > budget) {
+      usedBytes -= recent.back().bytes;
+      index.erase(recent.back().key);
+      recent.pop_back();
+      ++counters.evictions;
+    }
+  }
+
+ public:
+  // keeps at most budgetBytes of results in memory; results are also
+  // stored in directory unless it is empty, creating it if needed
+  explicit APSPCache(std::size_t budgetBytes, std::string directory = {})
+      : budget {budgetBytes}, directory {std::move(directory)} {
+    std::random_device seed {};
+    tempTag = static_cast<std::uint64_t>(seed()) << 32 | seed();
+    if (!this->directory.empty()) {
+      std::filesystem::create_directories(this->directory);
+    }
+  }
+
+  // the cached result for G, or nullptr; a disk hit is kept in memory
+  std::shared_ptr<const Rows> find(const Graph<T>& G) {
+    GraphFingerprint key = G.fingerprint();
+    {
+      std::lock_guard<std::mutex> lock {mutex};
+      auto found = index.find(key);
+      if (found != index.end()) {
+        recent.splice(recent.begin(), recent, found->second);
+        ++counters.hits;
+        return found->second->rows;
+      }
+    }
+    if (directory.empty()) {
+      return nullptr;
+    }
+    std::shared_ptr<const Rows> rows = readFile(key, G.size());
+    if (rows) {
+      std::lock_guard<std::mutex> lock {mutex};
+      ++counters.diskHits;
+      remember(key, rows);
+    }
+    return rows;
+  }
+
+  // stores rows as the result for G, on disk too if there is a directory
+  void insert(const Graph<T>& G, std::shared_ptr<const Rows> rows) {
+    GraphFingerprint key = G.fingerprint();
+    bool written = directory.empty() or writeFile(key, G.size(), *rows);
+    std::lock_guard<std::mutex> lock {mutex};
+    counters.diskWriteFailures += written ? 0 : 1;
+    remember(key, std::move(rows));
+  }
+
+  // the result of solve(G), which must return what johnsonAPSP would,
+  // solving only if G is not cached
+  template <typename Solve>
+    requires std::invocable<Solve&, const Graph<T>&>
+  std::shared_ptr<const Rows> get(const Graph<T>& G, Solve&& solve) {
+    if (std::shared_ptr<const Rows> rows = find(G)) {
+      return rows;
+    }
+    auto rows = std::make_shared<const Rows>(solve(G));
+    {
+      std::lock_guard<std::mutex> lock {mutex};
+      ++counters.misses;
+    }
+    insert(G, rows);
+    return rows;
+  }
+
+  // the result of johnsonAPSPWithOptions(G, options), solving only if G
+  // is not cached
+  std::shared_ptr<const Rows> get(const Graph<T>& G,
+                                  const APSPOptions& options = APSPOptions {}) {
+    return get(G, [&options](const Graph<T>& graph) {
+      return johnsonAPSPWithOptions(graph, options);
+    });
+  }
+
+  // drops every in-memory entry; files on disk are kept
+  void clear() {
+    std::lock_guard<std::mutex> lock {mutex};
+    recent.clear();
+    index.clear();
+    usedBytes = 0;
+  }
+
+  std::size_t bytesUsed() const {
+    std::lock_guard<std::mutex> lock {mutex};
+    return usedBytes;
+  }
+
+  APSPCacheStats stats() const {
+    std::lock_guard<std::mutex> lock {mutex};
+    return counters;
+  }
+};
+
+#endif      // CACHE_HPP_
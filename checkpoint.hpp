@@ -0,0 +1,301 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "graph.hpp"
+
+// Checkpoint and resume for long APSP runs
+// Both functions resume from checkpoint.path if it exists and otherwise
+// start from scratch, writing a checkpoint as they go. The file is left
+// in place when the run finishes, so repeating a finished run only reads
+// it back. A checkpoint written for a different graph, engine or weight
+// type is rejected with std::invalid_argument.
+//
+// The file is native-endian binary: a CheckpointHeader, then
+//   - Floyd-Warshall: the number of finished k iterations and the V x V
+//     matrix after them. Each checkpoint replaces the file whole by
+//     writing a temporary file and renaming it over the old one.
+//   - Johnson: the V potentials, then one record per finished source,
+//     its number followed by its row. Records are appended as rows finish
+//     and flushed every interval; a torn record at the end is dropped.
+// Cancellation through options.stopToken always leaves a checkpoint of
+// everything done so far.
+
+struct CheckpointOptions {
+  std::string path {};
+  // least time between two checkpoints; Floyd-Warshall writes the whole
+  // matrix each time, Johnson flushes the rows appended since the last
+  std::chrono::milliseconds interval {std::chrono::minutes {5}};
+};
+
+struct CheckpointHeader {
+  char magic[8] {};
+  std::uint32_t byteOrder {};
+  std::uint32_t formatVersion {};
+  // 1 for Johnson, 2 for Floyd-Warshall, 3 for a landmark index, 4 for
+  // a cached APSP result
+  std::uint32_t algorithm {};
+  // 0 for signed integers, 1 for unsigned integers, 2 for floating point
+  std::uint32_t weightKind {};
+  std::uint32_t weightSize {};
+  std::uint32_t reserved {};
+  std::int64_t numVertices {};
+  std::uint64_t graphDigest {};
+};
+
+inline constexpr char kCheckpointMagic[8] {'A', 'P', 'S', 'P',
+                                           'C', 'K', 'P', 'T'};
+inline constexpr std::uint32_t kCheckpointByteOrder = 0x01020304;
+inline constexpr std::uint32_t kCheckpointFormat = 1;
+
+// FNV-1a over the vertex count and the CSR arrays, so any change to the
+// edges or weights gives a different digest with high probability
+template <typename T>
+std::uint64_t graphDigest(const CSRGraph<T>& G) {
+  std::uint64_t hash = 0xCBF29CE484222325ULL;
+  auto mixBytes = [&hash](const void* data, std::size_t bytes) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < bytes; ++i) {
+      hash = (hash ^ p[i]) * 0x100000001B3ULL;
+    }
+  };
+  int V = G.size();
+  mixBytes(&V, sizeof V);
+  mixBytes(G.offsets.data(), G.offsets.size() * sizeof(int));
+  mixBytes(G.targets.data(), G.targets.size() * sizeof(int));
+  mixBytes(G.weights.data(), G.weights.size() * sizeof(T));
+  return hash;
+}
+
+template <typename T>
+CheckpointHeader checkpointHeader(std::uint32_t algorithm,
+                                  std::int64_t numVertices,
+                                  std::uint64_t digest) {
+  CheckpointHeader header {};
+  std::memcpy(header.magic, kCheckpointMagic, sizeof header.magic);
+  header.byteOrder = kCheckpointByteOrder;
+  header.formatVersion = kCheckpointFormat;
+  header.algorithm = algorithm;
+  header.weightKind = std::is_floating_point_v<T> ? 2
+                      : std::is_signed_v<T>       ? 0
+                                                  : 1;
+  header.weightSize = sizeof(T);
+  header.numVertices = numVertices;
+  header.graphDigest = digest;
+  return header;
+}
+
+template <typename T>
+CheckpointHeader checkpointHeader(std::uint32_t algorithm,
+                                  const CSRGraph<T>& G) {
+  return checkpointHeader<T>(algorithm, G.size(), graphDigest(G));
+}
+
+inline bool readBytes(std::istream& in, void* data, std::size_t bytes) {
+  in.read(static_cast<char*>(data), static_cast<std::streamsize>(bytes));
+  return static_cast<std::size_t>(in.gcount()) == bytes;
+}
+
+inline void writeBytes(std::ostream& out, const void* data,
+                       std::size_t bytes) {
+  out.write(static_cast<const char*>(data),
+            static_cast<std::streamsize>(bytes));
+}
+
+// opens a checkpoint and checks it was written for this run; returns a
+// closed stream if there is no checkpoint at path
+inline std::ifstream openCheckpoint(const std::string& path,
+                                    const CheckpointHeader& expected) {
+  std::ifstream in {path, std::ios::binary};
+  if (!in) {
+    return in;
+  }
+  CheckpointHeader header {};
+  if (!readBytes(in, &header, sizeof header) or
+      std::memcmp(&header, &expected, sizeof header) != 0) {
+    throw std::invalid_argument("checkpoint " + path +
+                                " was not written for this graph and engine");
+  }
+  return in;
+}
+
+// replaces path with the bytes write(out) produces, so a crash leaves
+// either the old file or the new one. The bytes go to temporary first,
+// path + ".tmp" unless given; writers that may race on the same path
+// need a temporary each
+template <typename Write>
+void replaceFile(const std::string& path, Write&& write,
+                 std::string temporary = {}) {
+  if (temporary.empty()) {
+    temporary = path + ".tmp";
+  }
+  {
+    std::ofstream out {temporary, std::ios::binary | std::ios::trunc};
+    write(out);
+    out.flush();
+    if (!out) {
+      throw std::runtime_error("could not write checkpoint " + temporary);
+    }
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+// Johnson's algorithm, resuming from and writing to a checkpoint
+// returns an empty matrix if G has a negative weight cycle
+template <typename T>
+std::vector<std::vector<T> >
+johnsonAPSPCheckpointed(const Graph<T>& G,
+                        const CheckpointOptions& checkpoint,
+                        const APSPOptions& options = APSPOptions {}) {
+  checkJohnsonOptions(options);
+  const int V = G.size();
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  CSRGraph<T> reweighted {G, options.resource};
+  std::pmr::vector<T> potential(V, T {}, options.resource);
+  std::vector<std::vector<T> > result(V);
+  const CheckpointHeader header = checkpointHeader(1, reweighted);
+  const std::size_t rowBytes = static_cast<std::size_t>(V) * sizeof(T);
+  std::ifstream in = openCheckpoint(checkpoint.path, header);
+  bool resumed = in.is_open();
+  if (resumed) {
+    if (!readBytes(in, potential.data(), rowBytes)) {
+      throw std::invalid_argument("checkpoint " + checkpoint.path +
+                                  " is truncated");
+    }
+    // keep every whole record, and cut the file after the last one
+    std::uintmax_t validBytes = sizeof header + rowBytes;
+    std::vector<T> row(V);
+    std::int32_t s {};
+    while (readBytes(in, &s, sizeof s) and s >= 0 and s < V and
+           readBytes(in, row.data(), rowBytes)) {
+      result[s] = row;
+      validBytes += sizeof s + rowBytes;
+    }
+    in.close();
+    if (std::filesystem::file_size(checkpoint.path) != validBytes) {
+      std::filesystem::resize_file(checkpoint.path, validBytes);
+    }
+  }
+  load.stop();
+
+  PhaseTimer reweight {&local.reweightTime};
+  if (!resumed) {
+    if (!bellmanFordPotentials(reweighted, potential, &local)) {
+      reweight.stop();
+      publishStats(options, local);
+      return {};
+    }
+    replaceFile(checkpoint.path, [&](std::ofstream& out) {
+      writeBytes(out, &header, sizeof header);
+      writeBytes(out, potential.data(), rowBytes);
+    });
+  }
+  reweightEdges(reweighted, potential);
+  reweight.stop();
+
+  std::ofstream out {checkpoint.path, std::ios::binary | std::ios::app};
+  std::mutex outMutex {};
+  auto lastFlush = std::chrono::steady_clock::now();
+  auto flush = [&]() {
+    out.flush();
+    if (!out) {
+      throw std::runtime_error("could not write checkpoint " +
+                               checkpoint.path);
+    }
+    lastFlush = std::chrono::steady_clock::now();
+  };
+  johnsonSearchRows(reweighted, potential, options, result, local,
+                    [&](int s) {
+    std::lock_guard<std::mutex> lock {outMutex};
+    std::int32_t source = s;
+    writeBytes(out, &source, sizeof source);
+    writeBytes(out, result[s].data(), rowBytes);
+    if (std::chrono::steady_clock::now() - lastFlush >= checkpoint.interval) {
+      flush();
+    }
+  });
+  flush();
+  publishStats(options, local);
+  return result;
+}
+
+// Floyd-Warshall, resuming from and writing to a checkpoint
+// returns an empty matrix if G has a negative weight cycle, and V empty
+// rows if cancelled
+template <typename T>
+std::vector<std::vector<T> >
+floydWarshallAPSPCheckpointed(const Graph<T>& G,
+                              const CheckpointOptions& checkpoint,
+                              const APSPOptions& options = APSPOptions {}) {
+  const int V = G.size();
+  const T inf = infinity<T>();
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  const CheckpointHeader header =
+      checkpointHeader(2, CSRGraph<T> {G, options.resource});
+  const std::size_t rowBytes = static_cast<std::size_t>(V) * sizeof(T);
+  auto dist = ownedMatrix<T>(V, options, [inf](int, std::span<T> row) {
+    std::fill(row.begin(), row.end(), inf);
+  });
+  std::int64_t firstK = 0;
+  std::ifstream in = openCheckpoint(checkpoint.path, header);
+  if (in.is_open()) {
+    bool whole = readBytes(in, &firstK, sizeof firstK) and firstK >= 0 and
+                 firstK <= V;
+    for (int i = 0; whole and i < V; ++i) {
+      whole = readBytes(in, dist.row(i), rowBytes);
+    }
+    if (!whole) {
+      throw std::invalid_argument("checkpoint " + checkpoint.path +
+                                  " is truncated");
+    }
+  } else {
+    for (int i = 0; i < V; ++i) {
+      dist(i, i) = T {};
+      for (const auto& [j, weight] : G.neighbours(i)) {
+        dist(i, j) = std::min(dist(i, j), weight);
+      }
+    }
+  }
+  load.stop();
+
+  auto save = [&](std::int64_t iterations) {
+    replaceFile(checkpoint.path, [&](std::ofstream& out) {
+      writeBytes(out, &header, sizeof header);
+      writeBytes(out, &iterations, sizeof iterations);
+      for (int i = 0; i < V; ++i) {
+        writeBytes(out, dist.row(i), rowBytes);
+      }
+    });
+  };
+  auto lastSave = std::chrono::steady_clock::now();
+  int iterations = floydWarshallIterations(
+      dist, static_cast<int>(firstK), options, local, [&](int k) {
+        if (k + 1 == V or options.stopToken.stop_requested() or
+            std::chrono::steady_clock::now() - lastSave >=
+                checkpoint.interval) {
+          save(k + 1);
+          lastSave = std::chrono::steady_clock::now();
+        }
+      });
+  publishStats(options, local);
+  if (iterations < 0) {
+    return {};
+  }
+  if (iterations < V) {
+    return std::vector<std::vector<T> >(V);
+  }
+  return dist.toRows();
+}
+
+#endif      // CHECKPOINT_HPP_
@@ -0,0 +1,317 @@
+#ifndef COMPRESSED_HPP_
+#define COMPRESSED_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+
+// Compressed storage for distance matrices with integer weights
+// Each row is cut into blocks of kCompressedBlock entries, and each block
+// is stored frame-of-reference: the smallest finite entry as its base,
+// then every entry as its difference from the base, bit-packed at the
+// narrowest width that holds the largest difference. If the block has
+// unreachable entries the all-ones code stands for infinity<T>(), and a
+// block whose entries are all equal is just its base with width 0.
+// A full block of width w fills exactly w 64-bit words. The last block
+// of a row is shorter when N is not a multiple of kCompressedBlock, and
+// its count entries take ceil(count * w / 64) words. Every block starts
+// on a word boundary, so an entry is found from its block header in
+// O(1). One spare word at the end lets extract() always read the word
+// after an entry.
+// decodeRow unpacks each full block with a decoder generated for its
+// width, straight-line code whose word offsets, shifts and masks are all
+// constants; only the short last block of a row takes the generic loop.
+
+inline constexpr int kCompressedBlock = 64;
+
+template <typename T>
+class CompressedDistanceMatrix {
+  static_assert(std::is_integral_v<T>,
+                "CompressedDistanceMatrix needs integer distances");
+
+ private:
+  using Code = std::uint64_t;
+
+  struct BlockHeader {
+    // first word of the packed codes
+    std::uint64_t firstWord {};
+    T base {};
+    std::uint8_t width {};
+    bool hasInfinity {};
+  };
+
+  std::vector<BlockHeader> headers {};
+  // one spare word at the end, so decoding may always read two words
+  std::vector<std::uint64_t> words {};
+  int numVertices {};
+  int blocksPerRow {};
+
+  // entries in block b of a row
+  int blockLength(int b) const {
+    return std::min(kCompressedBlock, numVertices - b * kCompressedBlock);
+  }
+
+  static Code difference(T value, T base) {
+    using Unsigned = std::make_unsigned_t<T>;
+    return static_cast<Unsigned>(static_cast<Unsigned>(value) -
+                                 static_cast<Unsigned>(base));
+  }
+
+  // inverse of difference
+  static T offset(T base, Code code) {
+    using Unsigned = std::make_unsigned_t<T>;
+    return static_cast<T>(static_cast<Unsigned>(
+        static_cast<Unsigned>(base) + static_cast<Unsigned>(code)));
+  }
+
+  // chooses base and width for the count entries at values
+  static BlockHeader describe(const T* values, int count) {
+    const T inf = infinity<T>();
+    BlockHeader header {};
+    T low = inf;
+    T high = inf;
+    for (int i = 0; i < count; ++i) {
+      if (values[i] == inf) {
+        header.hasInfinity = true;
+      } else {
+        low = low == inf ? values[i] : std::min(low, values[i]);
+        high = high == inf ? values[i] : std::max(high, values[i]);
+      }
+    }
+    header.base = low;
+    if (low == inf) {
+      // every entry is infinity
+      header.hasInfinity = false;
+      return header;
+    }
+    Code range = difference(high, low);
+    if (header.hasInfinity) {
+      // leaves the all-ones code free
+      ++range;
+    }
+    header.width = static_cast<std::uint8_t>(std::bit_width(range));
+    return header;
+  }
+
+  // number of words the block takes
+  static std::uint64_t blockWords(const BlockHeader& header, int count) {
+    return (static_cast<std::uint64_t>(count) * header.width + 63) / 64;
+  }
+
+  // code of entry i of a block; width must be non-zero
+  static Code extract(const std::uint64_t* packed, int width, int i) {
+    std::uint64_t bit = static_cast<std::uint64_t>(i) * width;
+    std::uint64_t word = bit / 64;
+    int shift = static_cast<int>(bit % 64);
+    // two shifts so that shift == 0 does not shift by 64
+    Code value = (packed[word] >> shift) |
+                 ((packed[word + 1] << 1) << (63 - shift));
+    Code mask = width == 64 ? ~Code {0} : (Code {1} << width) - 1;
+    return value & mask;
+  }
+
+  // entry K of a full block of width Width; the word and shifts are
+  // constants, and the second word is read only if the entry crosses it
+  template <int Width, int K>
+  static Code extractFixed(const std::uint64_t* packed) {
+    constexpr int bit = K * Width;
+    constexpr int shift = bit % 64;
+    constexpr Code mask = Width == 64 ? ~Code {0} : (Code {1} << Width) - 1;
+    Code value = packed[bit / 64] >> shift;
+    if constexpr (shift + Width > 64) {
+      value |= packed[bit / 64 + 1] << (64 - shift);
+    }
+    return value & mask;
+  }
+
+  template <int Width, int... K>
+  static void decodeFixed(const std::uint64_t* packed, T base, Code noCode,
+                          T* out, std::integer_sequence<int, K...>) {
+    const T inf = infinity<T>();
+    ((out[K] = extractFixed<Width, K>(packed) == noCode
+                   ? inf
+                   : offset(base, extractFixed<Width, K>(packed))),
+     ...);
+  }
+
+  // a full block of width Width, unrolled into straight-line code
+  template <int Width>
+  static void decodeFullBlock(const std::uint64_t* packed, T base,
+                              Code noCode, T* out) {
+    decodeFixed<Width>(packed, base, noCode, out,
+                       std::make_integer_sequence<int, kCompressedBlock> {});
+  }
+
+  using BlockDecoder = void (*)(const std::uint64_t*, T, Code, T*);
+
+  // decoder for full blocks of width w, 1 <= w <= 64
+  static BlockDecoder fullBlockDecoder(int w) {
+    static constexpr auto decoders =
+        []<int... W>(std::integer_sequence<int, W...>) {
+          return std::array<BlockDecoder, 64> {&decodeFullBlock<W + 1>...};
+        }(std::make_integer_sequence<int, 64> {});
+    return decoders[w - 1];
+  }
+
+  template <typename RowAccess>
+  void build(int N, RowAccess&& row, unsigned numThreads) {
+    numVertices = N;
+    blocksPerRow = (N + kCompressedBlock - 1) / kCompressedBlock;
+    headers.assign(static_cast<std::size_t>(N) * blocksPerRow, {});
+    std::vector<std::uint64_t> rowWords(N + 1, 0);
+    unsigned workers = workerCount(numThreads, N);
+    std::atomic<int> nextRow {0};
+    runWorkers(workers, [&](unsigned) {
+      for (int i = nextRow++; i < N; i = nextRow++) {
+        const T* values = row(i);
+        for (int b = 0; b < blocksPerRow; ++b) {
+          BlockHeader& header = headers[blockIndex(i, b)];
+          header = describe(values + b * kCompressedBlock, blockLength(b));
+          rowWords[i + 1] += blockWords(header, blockLength(b));
+        }
+      }
+    });
+    for (int i = 0; i < N; ++i) {
+      rowWords[i + 1] += rowWords[i];
+    }
+    words.assign(rowWords[N] + 1, 0);
+    nextRow = 0;
+    runWorkers(workers, [&](unsigned) {
+      for (int i = nextRow++; i < N; i = nextRow++) {
+        const T* values = row(i);
+        std::uint64_t next = rowWords[i];
+        for (int b = 0; b < blocksPerRow; ++b) {
+          BlockHeader& header = headers[blockIndex(i, b)];
+          header.firstWord = next;
+          next += blockWords(header, blockLength(b));
+          if (header.width != 0) {
+            pack(header, values + b * kCompressedBlock, blockLength(b));
+          }
+        }
+      }
+    });
+  }
+
+  void pack(const BlockHeader& header, const T* values, int count) {
+    const T inf = infinity<T>();
+    const int width = header.width;
+    const Code infinityCode = width == 64 ? ~Code {0}
+                                          : (Code {1} << width) - 1;
+    std::uint64_t* packed = words.data() + header.firstWord;
+    for (int i = 0; i < count; ++i) {
+      Code code = values[i] == inf ? infinityCode
+                                   : difference(values[i], header.base);
+      std::uint64_t bit = static_cast<std::uint64_t>(i) * width;
+      int shift = static_cast<int>(bit % 64);
+      packed[bit / 64] |= code << shift;
+      if (shift + width > 64) {
+        packed[bit / 64 + 1] |= code >> (64 - shift);
+      }
+    }
+  }
+
+  std::size_t blockIndex(int i, int b) const {
+    return static_cast<std::size_t>(i) * blocksPerRow + b;
+  }
+
+ public:
+  CompressedDistanceMatrix() = default;
+
+  // rows are compressed by numThreads workers (0 means
+  // std::thread::hardware_concurrency())
+  explicit CompressedDistanceMatrix(const DistanceMatrix<T>& M,
+                                    unsigned numThreads = 0) {
+    build(M.size(), [&M](int i) { return M.row(i); }, numThreads);
+  }
+
+  // compresses a row-per-vertex matrix such as johnsonAPSP returns
+  explicit CompressedDistanceMatrix(const std::vector<std::vector<T> >& M,
+                                    unsigned numThreads = 0) {
+    for (const std::vector<T>& row : M) {
+      if (row.size() != M.size()) {
+        throw std::invalid_argument("distance matrix must be square");
+      }
+    }
+    build(static_cast<int>(M.size()), [&M](int i) { return M[i].data(); },
+          numThreads);
+  }
+
+  int size() const {
+    return numVertices;
+  }
+
+  bool empty() const {
+    return numVertices == 0;
+  }
+
+  // bytes used by headers and packed codes
+  std::size_t bytes() const {
+    return headers.size() * sizeof(BlockHeader) +
+           words.size() * sizeof(std::uint64_t);
+  }
+
+  T operator()(int i, int j) const {
+    const BlockHeader& header = headers[blockIndex(i, j / kCompressedBlock)];
+    if (header.width == 0) {
+      return header.base;
+    }
+    Code code = extract(words.data() + header.firstWord, header.width,
+                        j % kCompressedBlock);
+    if (header.hasInfinity and code == (Code {2} << (header.width - 1)) - 1) {
+      return infinity<T>();
+    }
+    return offset(header.base, code);
+  }
+
+  // writes row i to out[0, size())
+  void decodeRow(int i, T* out) const {
+    const T inf = infinity<T>();
+    for (int b = 0; b < blocksPerRow; ++b) {
+      const BlockHeader& header = headers[blockIndex(i, b)];
+      const int count = blockLength(b);
+      T* block = out + b * kCompressedBlock;
+      if (header.width == 0) {
+        std::fill(block, block + count, header.base);
+        continue;
+      }
+      const std::uint64_t* packed = words.data() + header.firstWord;
+      const int width = header.width;
+      const Code infinityCode = (Code {2} << (width - 1)) - 1;
+      const Code noCode = header.hasInfinity ? infinityCode : ~Code {0};
+      const T base = header.base;
+      if (count == kCompressedBlock) {
+        fullBlockDecoder(width)(packed, base, noCode, block);
+        continue;
+      }
+      // the short last block of a row; an infinite entry is told apart by
+      // its code alone, so decoding takes no branch per entry
+      for (int k = 0; k < count; ++k) {
+        Code code = extract(packed, width, k);
+        block[k] = code == noCode ? inf : offset(base, code);
+      }
+    }
+  }
+
+  std::vector<T> row(int i) const {
+    std::vector<T> out(numVertices);
+    decodeRow(i, out.data());
+    return out;
+  }
+
+  DistanceMatrix<T> decompress() const {
+    DistanceMatrix<T> M {numVertices};
+    for (int i = 0; i < numVertices; ++i) {
+      decodeRow(i, M.row(i));
+    }
+    return M;
+  }
+};
+
+#endif      // COMPRESSED_HPP_
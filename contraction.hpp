@@ -0,0 +1,461 @@
+#ifndef CONTRACTION_HPP_
+#define CONTRACTION_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+
+// Contraction hierarchies
+// Preprocessing contracts the vertices one at a time, cheapest first by
+// edge difference (shortcuts added minus edges removed, plus the number
+// of neighbours already contracted, which spreads contraction evenly).
+// Contracting v adds a shortcut u -> w for each pair of remaining
+// neighbours unless a witness search finds a path from u to w avoiding v
+// that is no longer. Every shortest path then has a version that climbs
+// in contraction order and then descends, so a query is two small
+// Dijkstra searches over upward edges only, one from s and one backwards
+// from t. Distance tables use the bucket method: one backward search per
+// target leaves (target, distance) entries at the vertices it settles,
+// and one forward search per source scans them.
+// Weights must be non-negative.
+
+// settled vertices after which a witness search gives up and the
+// shortcut is added anyway, which keeps the hierarchy correct
+inline constexpr int kWitnessSettleLimit = 500;
+
+template <typename T>
+class ContractionHierarchy {
+ public:
+  // one direction of a search; reset between searches in O(1)
+  class SearchSide {
+   private:
+    std::vector<T> dist {};
+    std::vector<unsigned> stamp {};
+    std::vector<std::pair<T, int> > heap {};
+    unsigned generation {};
+
+    friend class ContractionHierarchy;
+
+    void start(int root) {
+      if (++generation == 0) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 1;
+      }
+      heap.clear();
+      reach(root, T {});
+    }
+
+    bool reached(int v) const {
+      return stamp[v] == generation;
+    }
+
+    T distance(int v) const {
+      return reached(v) ? dist[v] : infinity<T>();
+    }
+
+    void reach(int v, T d) {
+      stamp[v] = generation;
+      dist[v] = d;
+      heap.push_back({d, v});
+      std::push_heap(heap.begin(), heap.end(), std::greater<> {});
+    }
+
+    // pops the next vertex to settle, or returns -1 when there is none
+    int settleNext() {
+      while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<> {});
+        auto [d, v] = heap.back();
+        heap.pop_back();
+        if (d == dist[v]) {
+          return v;
+        }
+      }
+      return -1;
+    }
+
+    T minKey() const {
+      return heap.empty() ? infinity<T>() : heap.front().first;
+    }
+
+   public:
+    explicit SearchSide(int N) : dist(N), stamp(N, 0) {}
+  };
+
+  // per-thread workspace for point-to-point queries
+  class Search {
+   private:
+    SearchSide forward;
+    SearchSide backward;
+    int settledCount {};
+
+    friend class ContractionHierarchy;
+
+   public:
+    explicit Search(int N) : forward {N}, backward {N} {}
+
+    // vertices settled by the last query, in both directions
+    int settled() const {
+      return settledCount;
+    }
+  };
+
+ private:
+  int numVertices {};
+  std::size_t shortcutCount {};
+  // position of each vertex in the contraction order
+  std::vector<int> rankOf {};
+  // edges u -> w with rank w > rank u
+  CSRGraph<T> upward {0};
+  // row w lists the u with an edge u -> w and rank u > rank w
+  CSRGraph<T> upwardReverse {0};
+
+  using Edges = std::vector<std::vector<std::pair<int, T> > >;
+
+  // state while contracting
+  struct Builder {
+    Edges out;
+    Edges in;
+    std::vector<char> contracted;
+    std::vector<int> contractedNeighbours;
+    // marks the targets of the current witness search
+    std::vector<char> isTarget;
+    SearchSide witness;
+
+    explicit Builder(int N)
+        : out(N), in(N), contracted(N, 0), contractedNeighbours(N, 0),
+          isTarget(N, 0), witness {N} {}
+
+    static void addOrImprove(std::vector<std::pair<int, T> >& edges, int to,
+                             T weight) {
+      for (auto& [target, w] : edges) {
+        if (target == to) {
+          w = std::min(w, weight);
+          return;
+        }
+      }
+      edges.push_back({to, weight});
+    }
+
+    // Dijkstra from u over remaining vertices other than v, until it
+    // settles every target, passes distance limit or settles
+    // kWitnessSettleLimit vertices
+    void witnessSearch(int u, int v, T limit, int targets) {
+      witness.start(u);
+      for (int settled = 0; settled < kWitnessSettleLimit; ++settled) {
+        int x = witness.settleNext();
+        if (x < 0 or witness.dist[x] > limit) {
+          return;
+        }
+        if (isTarget[x] and --targets == 0) {
+          return;
+        }
+        for (const auto& [y, w] : out[x]) {
+          if (y == v or contracted[y]) {
+            continue;
+          }
+          T viaX = witness.dist[x] + w;
+          if (viaX <= limit and viaX < witness.distance(y)) {
+            witness.reach(y, viaX);
+          }
+        }
+      }
+    }
+
+    // number of shortcuts contracting v needs; adds them if apply
+    int contract(int v, bool apply) {
+      int needed = 0;
+      for (const auto& [u, toV] : in[v]) {
+        if (u == v or contracted[u]) {
+          continue;
+        }
+        T limit {};
+        int targets = 0;
+        for (const auto& [w, fromV] : out[v]) {
+          if (w != v and w != u and !contracted[w]) {
+            limit = targets == 0 ? toV + fromV
+                                 : std::max(limit, toV + fromV);
+            isTarget[w] = 1;
+            ++targets;
+          }
+        }
+        if (targets == 0) {
+          continue;
+        }
+        witnessSearch(u, v, limit, targets);
+        for (const auto& [w, fromV] : out[v]) {
+          isTarget[w] = 0;
+          if (w == v or w == u or contracted[w]) {
+            continue;
+          }
+          T via = toV + fromV;
+          if (witness.distance(w) > via) {
+            ++needed;
+            if (apply) {
+              addOrImprove(out[u], w, via);
+              addOrImprove(in[w], u, via);
+            }
+          }
+        }
+      }
+      return needed;
+    }
+
+    // drops the edges between v and its neighbours from the neighbours'
+    // lists, so later contractions do not scan them; v keeps its own
+    void detach(int v) {
+      auto drop = [v](std::vector<std::pair<int, T> >& edges) {
+        std::erase_if(edges, [v](const auto& edge) {
+          return edge.first == v;
+        });
+      };
+      for (const auto& [u, w] : in[v]) {
+        ++contractedNeighbours[u];
+        drop(out[u]);
+      }
+      for (const auto& [u, w] : out[v]) {
+        ++contractedNeighbours[u];
+        drop(in[u]);
+      }
+    }
+
+    int priority(int v) {
+      int removed = 0;
+      for (const auto& [u, w] : in[v]) {
+        removed += !contracted[u] and u != v;
+      }
+      for (const auto& [u, w] : out[v]) {
+        removed += !contracted[u] and u != v;
+      }
+      return contract(v, false) - removed + contractedNeighbours[v];
+    }
+  };
+
+  // CSR of the edges u -> w of out (or in) with rank w > rank u
+  CSRGraph<T> upwardEdges(const Edges& edges) const {
+    CSRGraph<T> G {numVertices};
+    for (int u = 0; u < numVertices; ++u) {
+      std::vector<std::pair<int, T> > row {};
+      for (const auto& [w, weight] : edges[u]) {
+        if (rankOf[w] > rankOf[u]) {
+          row.push_back({w, weight});
+        }
+      }
+      std::sort(row.begin(), row.end());
+      for (const auto& [w, weight] : row) {
+        G.targets.push_back(w);
+        G.weights.push_back(weight);
+      }
+      G.offsets[u + 1] = static_cast<int>(G.targets.size());
+    }
+    return G;
+  }
+
+  // settles every vertex reachable from root in G, calling visit(v, d)
+  template <typename Visit>
+  static void upwardSearch(const CSRGraph<T>& G, int root, SearchSide& side,
+                           Visit&& visit) {
+    side.start(root);
+    for (int u = side.settleNext(); u >= 0; u = side.settleNext()) {
+      T du = side.dist[u];
+      visit(u, du);
+      for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+        int w = G.targets[e];
+        T viaU = du + G.weights[e];
+        if (viaU < side.distance(w)) {
+          side.reach(w, viaU);
+        }
+      }
+    }
+  }
+
+  void checkVertex(int v) const {
+    if (v < 0 or v >= numVertices) {
+      throw std::out_of_range("invalid vertex number");
+    }
+  }
+
+ public:
+  // contracts G; throws std::invalid_argument on a negative weight
+  explicit ContractionHierarchy(const Graph<T>& G) : numVertices {G.size()} {
+    const int V = numVertices;
+    Builder builder {V};
+    for (int u = 0; u < V; ++u) {
+      for (const auto& [w, weight] : G.neighbours(u)) {
+        if (weight < T {}) {
+          throw std::invalid_argument(
+              "contraction hierarchies need non-negative weights");
+        }
+        // a self loop is never on a shortest path
+        if (w != u) {
+          builder.out[u].push_back({w, weight});
+          builder.in[w].push_back({u, weight});
+        }
+      }
+    }
+    using Entry = std::pair<int, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<> > queue {};
+    for (int v = 0; v < V; ++v) {
+      queue.push({builder.priority(v), v});
+    }
+    rankOf.assign(V, 0);
+    int nextRank = 0;
+    while (!queue.empty()) {
+      int v = queue.top().second;
+      queue.pop();
+      // lazy update: contract v only if it is still the cheapest
+      int current = builder.priority(v);
+      if (!queue.empty() and current > queue.top().first) {
+        queue.push({current, v});
+        continue;
+      }
+      shortcutCount += builder.contract(v, true);
+      builder.contracted[v] = 1;
+      rankOf[v] = nextRank++;
+      builder.detach(v);
+    }
+    upward = upwardEdges(builder.out);
+    upwardReverse = upwardEdges(builder.in);
+  }
+
+  int size() const {
+    return numVertices;
+  }
+
+  // shortcut edges added by preprocessing
+  std::size_t shortcuts() const {
+    return shortcutCount;
+  }
+
+  // position of v in the contraction order
+  int rank(int v) const {
+    checkVertex(v);
+    return rankOf[v];
+  }
+
+  // exact d(s, t) by bidirectional upward search
+  T distance(int s, int t, Search& search) const {
+    checkVertex(s);
+    checkVertex(t);
+    SearchSide& forward = search.forward;
+    SearchSide& backward = search.backward;
+    search.settledCount = 0;
+    forward.start(s);
+    backward.start(t);
+    T best = infinity<T>();
+    // each direction stops once its queue cannot beat best
+    while (true) {
+      bool goForward = forward.minKey() < best;
+      bool goBackward = backward.minKey() < best;
+      if (!goForward and !goBackward) {
+        break;
+      }
+      if (goForward and goBackward) {
+        goForward = forward.minKey() <= backward.minKey();
+      }
+      SearchSide& side = goForward ? forward : backward;
+      const SearchSide& other = goForward ? backward : forward;
+      const CSRGraph<T>& G = goForward ? upward : upwardReverse;
+      int u = side.settleNext();
+      if (u < 0) {
+        continue;
+      }
+      ++search.settledCount;
+      T du = side.dist[u];
+      if (other.reached(u) and du + other.dist[u] < best) {
+        best = du + other.dist[u];
+      }
+      for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+        int w = G.targets[e];
+        T viaU = du + G.weights[e];
+        if (viaU < side.distance(w)) {
+          side.reach(w, viaU);
+          if (other.reached(w) and viaU + other.dist[w] < best) {
+            best = viaU + other.dist[w];
+          }
+        }
+      }
+    }
+    return best;
+  }
+
+  // exact d(s, t) with a workspace of its own, which costs O(V)
+  T distance(int s, int t) const {
+    Search search {numVertices};
+    return distance(s, t, search);
+  }
+
+  // table[i][j] is the distance from sources[i] to targets[j], computed
+  // by numThreads workers (0 means std::thread::hardware_concurrency())
+  std::vector<std::vector<T> >
+  manyToMany(const std::vector<int>& sources, const std::vector<int>& targets,
+             unsigned numThreads = 0) const {
+    for (int v : sources) {
+      checkVertex(v);
+    }
+    for (int v : targets) {
+      checkVertex(v);
+    }
+    const int numSources = static_cast<int>(sources.size());
+    const int numTargets = static_cast<int>(targets.size());
+    // backward searches, then the entries sorted into per-vertex buckets
+    std::vector<std::vector<std::pair<int, T> > > reachedFrom(numTargets);
+    std::atomic<int> next {0};
+    runWorkers(workerCount(numThreads, numTargets), [&](unsigned) {
+      SearchSide side {numVertices};
+      for (int j = next++; j < numTargets; j = next++) {
+        upwardSearch(upwardReverse, targets[j], side, [&](int v, T d) {
+          reachedFrom[j].push_back({v, d});
+        });
+      }
+    });
+    std::vector<int> bucketStart(numVertices + 1, 0);
+    for (const auto& entries : reachedFrom) {
+      for (const auto& [v, d] : entries) {
+        ++bucketStart[v + 1];
+      }
+    }
+    for (int v = 0; v < numVertices; ++v) {
+      bucketStart[v + 1] += bucketStart[v];
+    }
+    std::vector<std::pair<int, T> > buckets(bucketStart[numVertices]);
+    {
+      std::vector<int> fill(bucketStart.begin(), bucketStart.end() - 1);
+      for (int j = 0; j < numTargets; ++j) {
+        for (const auto& [v, d] : reachedFrom[j]) {
+          buckets[fill[v]++] = {j, d};
+        }
+      }
+    }
+
+    std::vector<std::vector<T> > table(numSources,
+                                       std::vector<T>(numTargets,
+                                                      infinity<T>()));
+    next = 0;
+    runWorkers(workerCount(numThreads, numSources), [&](unsigned) {
+      SearchSide side {numVertices};
+      for (int i = next++; i < numSources; i = next++) {
+        std::vector<T>& row = table[i];
+        upwardSearch(upward, sources[i], side, [&](int u, T d) {
+          for (int b = bucketStart[u]; b < bucketStart[u + 1]; ++b) {
+            auto [j, toTarget] = buckets[b];
+            row[j] = std::min(row[j], d + toTarget);
+          }
+        });
+      }
+    });
+    return table;
+  }
+
+  // distances from source to each of targets
+  std::vector<T> oneToMany(int source, const std::vector<int>& targets,
+                           unsigned numThreads = 0) const {
+    return manyToMany({source}, targets, numThreads)[0];
+  }
+};
+
+#endif      // CONTRACTION_HPP_
@@ -0,0 +1,107 @@
+#ifndef FIXED_HPP_
+#define FIXED_HPP_
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include "graph.hpp"
+
+// Floyd-Warshall for graphs whose size is known at compile time
+// The matrix is a std::array of N rows of N entries, so a solve never
+// touches the heap, every loop has a constant trip count the compiler
+// can unroll and vectorise, and at N <= kFixedMaxVertices the whole
+// matrix fits in L1. Everything is constexpr, so a fixed topology can be
+// solved during compilation:
+//   constexpr auto D = fixedFloydWarshallAPSP(
+//       fixedAdjacencyMatrix<int, 3>(std::array {FixedEdge<int> {0, 1, 4},
+//                                                FixedEdge<int> {1, 2, 1}}));
+//   static_assert((*D)[0][2] == 5);
+
+inline constexpr std::size_t kFixedMaxVertices = 64;
+
+template <typename T, std::size_t N>
+using FixedMatrix = std::array<std::array<T, N>, N>;
+
+// edge from vertex from to vertex to with the given weight
+template <typename T>
+struct FixedEdge {
+  std::size_t from {};
+  std::size_t to {};
+  T weight {};
+};
+
+// one-hop distances: 0 on the diagonal, the lightest edge weight where
+// there is an edge and infinity elsewhere. Throws std::out_of_range for
+// an endpoint outside [0, N), which fails a constant evaluation
+template <typename T, std::size_t N, std::size_t E>
+constexpr FixedMatrix<T, N> fixedAdjacencyMatrix(
+    const std::array<FixedEdge<T>, E>& edges) {
+  FixedMatrix<T, N> dist {};
+  for (std::size_t i = 0; i < N; ++i) {
+    for (std::size_t j = 0; j < N; ++j) {
+      dist[i][j] = i == j ? T {} : infinity<T>();
+    }
+  }
+  for (const FixedEdge<T>& edge : edges) {
+    if (edge.from >= N or edge.to >= N) {
+      throw std::out_of_range("invalid vertex number");
+    }
+    T& entry = dist[edge.from][edge.to];
+    entry = edge.weight < entry ? edge.weight : entry;
+  }
+  return dist;
+}
+
+// the same for a graph built at run time, which must have N vertices
+template <typename T, std::size_t N>
+FixedMatrix<T, N> fixedAdjacencyMatrix(const Graph<T>& G) {
+  if (G.size() != static_cast<int>(N)) {
+    throw std::invalid_argument("graph does not have N vertices");
+  }
+  FixedMatrix<T, N> dist = fixedAdjacencyMatrix<T, N>(
+      std::array<FixedEdge<T>, 0> {});
+  for (int i = 0; i < G.size(); ++i) {
+    for (const auto& [j, weight] : G.neighbours(i)) {
+      dist[i][j] = std::min(dist[i][j], weight);
+    }
+  }
+  return dist;
+}
+
+// all-pairs shortest paths from one-hop distances such as
+// fixedAdjacencyMatrix returns; std::nullopt if there is a negative
+// weight cycle. A negative cycle whose largest vertex is k shows up as
+// dist[k][k] < 0 before round k, so the loop stops there: pivoting on k
+// would double entries every round until int overflows, which is a
+// hard error in a constant evaluation
+template <typename T, std::size_t N>
+constexpr std::optional<FixedMatrix<T, N> >
+fixedFloydWarshallAPSP(FixedMatrix<T, N> dist) {
+  static_assert(N <= kFixedMaxVertices,
+                "use floydWarshallAPSP for more than kFixedMaxVertices");
+  const T inf = infinity<T>();
+  for (std::size_t k = 0; k < N; ++k) {
+    if (dist[k][k] < T {}) {
+      return std::nullopt;
+    }
+    // row k does not change during iteration k; the copy tells the
+    // compiler it cannot alias row i
+    const std::array<T, N> rowK = dist[k];
+    for (std::size_t i = 0; i < N; ++i) {
+      const T dik = dist[i][k];
+      if (dik == inf) {
+        continue;
+      }
+      // dik is finite here, so only rowK[j] can be infinity; selecting
+      // rather than skipping keeps the N-long loop free of branches
+      for (std::size_t j = 0; j < N; ++j) {
+        T via = rowK[j] == inf ? inf : dik + rowK[j];
+        dist[i][j] = via < dist[i][j] ? via : dist[i][j];
+      }
+    }
+  }
+  return dist;
+}
+
+#endif      // FIXED_HPP_
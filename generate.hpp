@@ -0,0 +1,318 @@
+#ifndef GENERATE_HPP_
+#define GENERATE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "graph.hpp"
+
+// Random graph generators
+// Every generator writes a CSRGraph directly and costs O(V + E). Random
+// numbers come from counter-based streams: the value drawn is a pure
+// function of (seed, stream, counter), with one stream per row or per
+// edge, so workers can produce any part of the graph independently and
+// the result for a given seed does not depend on the number of threads.
+
+// counter-based random stream built on the SplitMix64 finaliser
+class CounterRNG {
+ private:
+  std::uint64_t key {};
+  std::uint64_t counter {};
+
+  static std::uint64_t mix(std::uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+ public:
+  CounterRNG(std::uint64_t seed, std::uint64_t stream)
+      : key {mix(seed ^ mix(stream + 0x9E3779B97F4A7C15ULL))} {}
+
+  std::uint64_t next() {
+    return mix(key + 0x9E3779B97F4A7C15ULL * ++counter);
+  }
+
+  // uniform in [0, 1)
+  double uniform() {
+    return static_cast<double>(next() >> 11) * 0x1.0p-53;
+  }
+
+  // uniform in [low, high]
+  template <typename T>
+  T between(T low, T high) {
+    if constexpr (std::is_integral_v<T>) {
+      auto span = static_cast<std::uint64_t>(high) -
+                  static_cast<std::uint64_t>(low) + 1;
+      // added modulo 2^64, as the offset need not fit in T
+      return static_cast<T>(static_cast<std::uint64_t>(low) +
+                            (span == 0 ? next() : next() % span));
+    } else {
+      return low + static_cast<T>(uniform()) * (high - low);
+    }
+  }
+};
+
+struct GeneratorOptions {
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+  // worker threads; 0 means std::thread::hardware_concurrency()
+  unsigned numThreads = 0;
+  // whether edges (v, v) may be generated
+  bool selfLoops = true;
+};
+
+// streams are split into domains so that, for example, the weights of
+// row i never reuse the numbers that chose its targets
+inline constexpr std::uint64_t kTargetStreams = 0;
+inline constexpr std::uint64_t kWeightStreams = 1ULL << 62;
+
+// fills a CSR graph of V vertices in two parallel passes: rowDegree(v)
+// returns the out-degree of v, then writeRow(v, targets, weights) writes
+// that many edges, sorted by target
+template <typename T, typename RowDegree, typename WriteRow>
+CSRGraph<T> buildRows(int V, const GeneratorOptions& options,
+                      RowDegree&& rowDegree, WriteRow&& writeRow) {
+  CSRGraph<T> G {V, options.resource};
+  unsigned workers = workerCount(options.numThreads, V);
+  std::atomic<int> nextRow {0};
+  constexpr int kRowsPerTask = 256;
+  runWorkers(workers, [&](unsigned) {
+    for (int first = nextRow.fetch_add(kRowsPerTask); first < V;
+         first = nextRow.fetch_add(kRowsPerTask)) {
+      for (int v = first; v < std::min(V, first + kRowsPerTask); ++v) {
+        G.offsets[v + 1] = rowDegree(v);
+      }
+    }
+  });
+  long long total = 0;
+  for (int v = 0; v < V; ++v) {
+    total += G.offsets[v + 1];
+    if (total > std::numeric_limits<int>::max()) {
+      throw std::length_error("too many edges for int offsets");
+    }
+    G.offsets[v + 1] = static_cast<int>(total);
+  }
+  G.targets.resize(total);
+  G.weights.resize(total);
+  nextRow = 0;
+  runWorkers(workers, [&](unsigned) {
+    for (int first = nextRow.fetch_add(kRowsPerTask); first < V;
+         first = nextRow.fetch_add(kRowsPerTask)) {
+      for (int v = first; v < std::min(V, first + kRowsPerTask); ++v) {
+        writeRow(v, G.targets.data() + G.offsets[v],
+                 G.weights.data() + G.offsets[v]);
+      }
+    }
+  });
+  return G;
+}
+
+// Erdős–Rényi G(N, p): each ordered pair is an edge with probability p.
+// Rather than a trial per pair, the gap to the next edge in a row is
+// drawn from the geometric distribution, so a row costs O(its degree)
+template <typename T>
+CSRGraph<T> erdosRenyiGraph(int N, double p, std::uint64_t seed,
+                            T minWeight, T maxWeight,
+                            const GeneratorOptions& options =
+                                GeneratorOptions {}) {
+  if (N < 0 or p < 0 or p > 1) {
+    throw std::invalid_argument("need N >= 0 and 0 <= p <= 1");
+  }
+  const double logMiss = std::log1p(-p);
+  // visits the targets of row v in increasing order
+  auto forEachTarget = [&](int v, auto&& visit) {
+    if (p == 0) {
+      return;
+    }
+    CounterRNG rng {seed, kTargetStreams + static_cast<std::uint64_t>(v)};
+    long long j = -1;
+    while (true) {
+      if (p < 1) {
+        // 1 - uniform() is in (0, 1], so the skip is finite, but for a
+        // tiny p it can exceed any integer; past N it ends the row anyway
+        double skip = std::floor(std::log(1 - rng.uniform()) / logMiss);
+        skip = std::min(skip, static_cast<double>(N));
+        j += 1 + static_cast<long long>(skip);
+      } else {
+        ++j;
+      }
+      if (j >= N) {
+        return;
+      }
+      if (options.selfLoops or j != v) {
+        visit(static_cast<int>(j));
+      }
+    }
+  };
+  return buildRows<T>(
+      N, options,
+      [&](int v) {
+        int degree = 0;
+        forEachTarget(v, [&degree](int) { ++degree; });
+        return degree;
+      },
+      [&](int v, int* targets, T* weights) {
+        CounterRNG weightRNG {seed,
+                              kWeightStreams + static_cast<std::uint64_t>(v)};
+        forEachTarget(v, [&](int j) {
+          *targets++ = j;
+          *weights++ = weightRNG.between(minWeight, maxWeight);
+        });
+      });
+}
+
+// R-MAT power-law graph on 2^scale vertices: each of numEdges edges picks
+// its endpoints by descending scale times into one quadrant of the
+// adjacency matrix with probabilities a, b, c and 1 - a - b - c.
+// Duplicate edges are merged keeping the smallest weight, so the result
+// can have fewer than numEdges edges
+template <typename T>
+CSRGraph<T> rmatGraph(int scale, std::size_t numEdges, std::uint64_t seed,
+                      T minWeight, T maxWeight, double a = 0.57,
+                      double b = 0.19, double c = 0.19,
+                      const GeneratorOptions& options = GeneratorOptions {}) {
+  if (scale < 0 or scale > 30 or a < 0 or b < 0 or c < 0 or a + b + c > 1) {
+    throw std::invalid_argument("need 0 <= scale <= 30 and a + b + c <= 1");
+  }
+  if (numEdges > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    throw std::length_error("too many edges for int offsets");
+  }
+  const int V = 1 << scale;
+  const long long E = static_cast<long long>(numEdges);
+  // quadrant thresholds on a 32-bit uniform
+  const double twoTo32 = 4294967296.0;
+  const auto toB = static_cast<std::uint64_t>(a * twoTo32);
+  const auto toC = static_cast<std::uint64_t>((a + b) * twoTo32);
+  const auto toD = static_cast<std::uint64_t>((a + b + c) * twoTo32);
+  std::pmr::vector<int> sources(E, options.resource);
+  std::pmr::vector<int> targets(E, options.resource);
+  std::pmr::vector<T> weights(E, options.resource);
+  // edge e only reads stream e, so the edge list is the same for any
+  // number of workers
+  std::atomic<long long> nextEdge {0};
+  constexpr long long kEdgesPerTask = 4096;
+  runWorkers(workerCount(options.numThreads, static_cast<int>(E / 64)),
+             [&](unsigned) {
+    for (long long first = nextEdge.fetch_add(kEdgesPerTask); first < E;
+         first = nextEdge.fetch_add(kEdgesPerTask)) {
+      for (long long e = first; e < std::min(E, first + kEdgesPerTask); ++e) {
+        CounterRNG rng {seed, static_cast<std::uint64_t>(e)};
+        int u = 0;
+        int v = 0;
+        do {
+          u = 0;
+          v = 0;
+          // 32 random bits per level, two levels per draw; the quadrant
+          // is the number of thresholds the bits reach
+          std::uint64_t bits = 0;
+          for (int level = 0; level < scale; ++level) {
+            if (level % 2 == 0) {
+              bits = rng.next();
+            }
+            std::uint64_t r = (bits >> (32 * (level % 2))) & 0xFFFFFFFFULL;
+            int quadrant = (r >= toB) + (r >= toC) + (r >= toD);
+            u = 2 * u + (quadrant >> 1);
+            v = 2 * v + (quadrant & 1);
+          }
+        } while (!options.selfLoops and u == v and V > 1);
+        sources[e] = u;
+        targets[e] = v;
+        weights[e] = rng.between(minWeight, maxWeight);
+      }
+    }
+  });
+
+  // bucket by source, then sort and merge each row
+  std::pmr::vector<int> start(V + 1, 0, options.resource);
+  for (long long e = 0; e < E; ++e) {
+    ++start[sources[e] + 1];
+  }
+  for (int v = 0; v < V; ++v) {
+    start[v + 1] += start[v];
+  }
+  std::pmr::vector<std::pair<int, T> > bucketed(E, options.resource);
+  {
+    std::pmr::vector<int> fill(start.begin(), start.end() - 1,
+                               options.resource);
+    for (long long e = 0; e < E; ++e) {
+      bucketed[fill[sources[e]]++] = {targets[e], weights[e]};
+    }
+  }
+  std::pmr::vector<int> degree(V, 0, options.resource);
+  auto mergeRow = [&](int v) {
+    auto first = bucketed.begin() + start[v];
+    auto last = bucketed.begin() + start[v + 1];
+    std::sort(first, last);
+    // after sorting, the first copy of each target has the least weight
+    auto end = std::unique(first, last, [](const auto& x, const auto& y) {
+      return x.first == y.first;
+    });
+    return static_cast<int>(end - first);
+  };
+  std::atomic<int> nextRow {0};
+  runWorkers(workerCount(options.numThreads, V), [&](unsigned) {
+    for (int v = nextRow++; v < V; v = nextRow++) {
+      degree[v] = mergeRow(v);
+    }
+  });
+  return buildRows<T>(
+      V, options, [&](int v) { return degree[v]; },
+      [&](int v, int* rowTargets, T* rowWeights) {
+        for (int i = 0; i < degree[v]; ++i) {
+          rowTargets[i] = bucketed[start[v] + i].first;
+          rowWeights[i] = bucketed[start[v] + i].second;
+        }
+      });
+}
+
+// road-like grid: vertex r * cols + c has an edge to each of its up to
+// four horizontal and vertical neighbours, every edge with its own random
+// weight, so the graph is sparse, planar and of large diameter
+template <typename T>
+CSRGraph<T> gridGraph(int rows, int cols, std::uint64_t seed, T minWeight,
+                      T maxWeight,
+                      const GeneratorOptions& options = GeneratorOptions {}) {
+  if (rows < 0 or cols < 0 or
+      static_cast<long long>(rows) * cols > std::numeric_limits<int>::max()) {
+    throw std::invalid_argument("grid dimensions out of range");
+  }
+  const int V = rows * cols;
+  // neighbours of v in increasing vertex order
+  auto forEachNeighbour = [rows, cols](int v, auto&& visit) {
+    int r = v / cols;
+    int c = v % cols;
+    if (r > 0) {
+      visit(v - cols);
+    }
+    if (c > 0) {
+      visit(v - 1);
+    }
+    if (c + 1 < cols) {
+      visit(v + 1);
+    }
+    if (r + 1 < rows) {
+      visit(v + cols);
+    }
+  };
+  return buildRows<T>(
+      V, options,
+      [&](int v) {
+        int degree = 0;
+        forEachNeighbour(v, [&degree](int) { ++degree; });
+        return degree;
+      },
+      [&](int v, int* targets, T* weights) {
+        CounterRNG rng {seed, kWeightStreams + static_cast<std::uint64_t>(v)};
+        forEachNeighbour(v, [&](int u) {
+          *targets++ = u;
+          *weights++ = rng.between(minWeight, maxWeight);
+        });
+      });
+}
+
+#endif      // GENERATE_HPP_
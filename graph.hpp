@@ -10,19 +10,125 @@
 #include <queue>
 #include <unordered_map>
 #include <limits>
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include "numa.hpp"
+
+// AVX2 kernels (batchedDijkstra lanes, minplus.hpp) are built into every
+// x86 build: as they are if the compiler already targets AVX2, otherwise
+// as target("avx2") functions only called when cpuHasAVX2()
+#if defined(__AVX2__)
+#define GRAPH_AVX2
+#define GRAPH_AVX2_TARGET
+#elif (defined(__GNUC__) or defined(__clang__)) and \
+    (defined(__x86_64__) or defined(__i386__))
+#define GRAPH_AVX2
+#define GRAPH_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#ifdef GRAPH_AVX2
+#include <immintrin.h>
+#endif
+
+// 128-bit content hash of a graph: equal graphs always have equal
+// fingerprints, and different ones collide with probability about 2^-128
+struct GraphFingerprint {
+  std::uint64_t low {};
+  std::uint64_t high {};
+
+  bool operator==(const GraphFingerprint&) const = default;
+};
+
+// splitmix64 finaliser, a bijection that spreads every input bit
+constexpr std::uint64_t mixBits(std::uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// one lane of the hash of edge (i, j, weight), seeded so the two lanes
+// of a fingerprint are independent
+template <typename T>
+std::uint64_t edgeHash(int i, int j, const T& weight, std::uint64_t seed) {
+  std::uint64_t ends =
+      static_cast<std::uint64_t>(static_cast<std::uint32_t>(i)) << 32 |
+      static_cast<std::uint32_t>(j);
+  std::uint64_t h = mixBits(seed ^ ends);
+  // the weight's bytes, 8 at a time
+  unsigned char bytes[(sizeof(T) + 7) / 8 * 8] {};
+  std::memcpy(bytes, &weight, sizeof(T));
+  for (std::size_t k = 0; k < sizeof bytes; k += 8) {
+    std::uint64_t word {};
+    std::memcpy(&word, bytes + k, 8);
+    h = mixBits(h ^ word);
+  }
+  return h;
+}
 
 template <typename T>
 class Graph {
+ public:
+  using AdjacencyMap = std::pmr::unordered_map<int, T>;
+  // (source, weight) of an edge into a vertex
+  using InEdge = std::pair<int, T>;
+
  private:
-  std::vector<std::unordered_map<int, T> > adjList {};
+  // reverse CSR of the graph, built on first use and dropped by any edit;
+  // the arrays are emplaced on each build so that they are allocated from
+  // the graph's resource (assigning a vector would keep the default one)
+  struct InEdgeCache {
+    std::mutex mutex {};
+    std::atomic<bool> valid {false};
+    std::optional<std::pmr::vector<int> > offsets {};
+    std::optional<std::pmr::vector<InEdge> > edges {};
+
+    InEdgeCache() = default;
+
+    // a copy starts without a cache and builds its own on first use
+    InEdgeCache(const InEdgeCache&) {}
+
+    InEdgeCache& operator=(const InEdgeCache&) {
+      valid = false;
+      return *this;
+    }
+  };
+
+  std::pmr::vector<AdjacencyMap> adjList {};
   int numVertices {};
+  mutable InEdgeCache inEdgeCache {};
+  // sums of the two lanes of edgeHash over every edge, kept up to date by
+  // addEdge and removeEdge; a sum does not depend on insertion order
+  GraphFingerprint edgeSum {};
+
+  static constexpr std::uint64_t kLowSeed = 0x9E3779B97F4A7C15ULL;
+  static constexpr std::uint64_t kHighSeed = 0xC2B2AE3D27D4EB4FULL;
+
+  void buildInEdges(unsigned numThreads) const;
 
  public:
   // empty graph with N vertices
-  explicit Graph(int N);
+  // adjacency storage is allocated from resource
+  explicit Graph(int N, std::pmr::memory_resource* resource =
+                            std::pmr::get_default_resource());
 
   // construct graph from edge list in filename
-  explicit Graph(const std::string& filename);
+  explicit Graph(const std::string& filename,
+                 std::pmr::memory_resource* resource =
+                     std::pmr::get_default_resource());
 
   // add an edge directed from vertex i to vertex j with given weight
   void addEdge(int i, int j, T weight);
@@ -40,17 +146,43 @@ class Graph {
   // returns number of vertices in the graph
   int size() const;
 
+  // returns number of edges in the graph
+  std::size_t numEdges() const;
+
+  // memory resource the adjacency storage is allocated from
+  std::pmr::memory_resource* resource() const {
+    return adjList.get_allocator().resource();
+  }
+
   // return iterator to a particular vertex
-  const std::unordered_map<int, T>& neighbours(int a) const {
+  const AdjacencyMap& neighbours(int a) const {
     return adjList.at(a);
   }
+
+  // edges into vertex a, sorted by source; the first call after an edit
+  // rebuilds the reverse index for every vertex in O(V + E) with
+  // numThreads workers (0 means std::thread::hardware_concurrency()).
+  // Safe to call from several threads while nobody edits the graph.
+  // addEdge and removeEdge invalidate every span returned so far, as
+  // does assigning to the graph; use them only until the next edit
+  std::span<const InEdge> inNeighbours(int a, unsigned numThreads = 1) const;
+
+  // hash of the vertex count and every (i, j, weight), in O(1); weights
+  // are hashed by their bytes, so 0.0 and -0.0 differ
+  GraphFingerprint fingerprint() const {
+    return {edgeSum.low + mixBits(kLowSeed ^ numVertices),
+            edgeSum.high + mixBits(kHighSeed ^ numVertices)};
+  }
 };
 
 template <typename T>
-Graph<T>::Graph(int N) : adjList(N), numVertices {N} {}
+Graph<T>::Graph(int N, std::pmr::memory_resource* resource)
+    : adjList(N, resource), numVertices {N} {}
 
 template <typename T>
-Graph<T>::Graph(const std::string& inputFile) {
+Graph<T>::Graph(const std::string& inputFile,
+                std::pmr::memory_resource* resource)
+    : adjList(resource) {
   std::ifstream infile {inputFile};
   if (!infile) {
     std::cerr << inputFile << " could not be opened\n";
@@ -74,19 +206,38 @@ int Graph<T>::size() const {
   return numVertices;
 }
 
+template <typename T>
+std::size_t Graph<T>::numEdges() const {
+  std::size_t count {};
+  for (const auto& edges : adjList) {
+    count += edges.size();
+  }
+  return count;
+}
+
 template <typename T>
 void Graph<T>::addEdge(int i, int j, T weight) {
   if (i < 0 or i >= numVertices or j < 0 or j >= numVertices) {
     throw std::out_of_range("invalid vertex number");
   }
-  adjList[i].insert({j, weight});
+  if (adjList[i].insert({j, weight}).second) {
+    edgeSum.low += edgeHash(i, j, weight, kLowSeed);
+    edgeSum.high += edgeHash(i, j, weight, kHighSeed);
+  }
+  inEdgeCache.valid = false;
 }
 
 template <typename T>
 void Graph<T>::removeEdge(int i, int j) {
   // check if i and j are valid
   if (i >= 0 && i < numVertices && j >= 0 && j < numVertices) {
-    adjList[i].erase(j);
+    auto found = adjList[i].find(j);
+    if (found != adjList[i].end()) {
+      edgeSum.low -= edgeHash(i, j, found->second, kLowSeed);
+      edgeSum.high -= edgeHash(i, j, found->second, kHighSeed);
+      adjList[i].erase(found);
+    }
+    inEdgeCache.valid = false;
   }
 }
 
@@ -116,11 +267,305 @@ std::ostream& operator<<(std::ostream& out, const Graph<T>& G) {
 }
 
 
+// Compressed sparse row snapshot of a Graph
+// out-edges of vertex v are targets/weights[offsets[v], offsets[v + 1])
+// sorted by target; the APSP engines scan this instead of the hash maps.
+// Targets and weights are separate arrays, so scans that only follow
+// edges (BFS, SCC) never load weights, and targets are stored as Index,
+// which can be narrower than int for small graphs (see withVertexIndex)
+template <typename T, typename Index = int>
+struct CSRGraph {
+  using VertexIndex = Index;
+
+  std::pmr::vector<int> offsets;
+  std::pmr::vector<Index> targets;
+  std::pmr::vector<T> weights;
+
+  explicit CSRGraph(const Graph<T>& G,
+                    std::pmr::memory_resource* resource =
+                        std::pmr::get_default_resource());
+
+  // N vertices and no edges
+  explicit CSRGraph(int N, std::pmr::memory_resource* resource =
+                               std::pmr::get_default_resource())
+      : offsets(N + 1, 0, resource), targets(resource), weights(resource) {}
+
+  int size() const {
+    return static_cast<int>(offsets.size()) - 1;
+  }
+
+  std::size_t numEdges() const {
+    return targets.size();
+  }
+};
+
+template <typename T, typename Index>
+CSRGraph<T, Index>::CSRGraph(const Graph<T>& G,
+                             std::pmr::memory_resource* resource)
+    : offsets(G.size() + 1, 0, resource), targets(resource),
+      weights(resource) {
+  std::size_t E = G.numEdges();
+  targets.reserve(E);
+  weights.reserve(E);
+  std::pmr::vector<std::pair<int, T> > row(resource);
+  for (int v = 0; v < G.size(); ++v) {
+    row.assign(G.neighbours(v).begin(), G.neighbours(v).end());
+    std::sort(row.begin(), row.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& [neighbour, weight] : row) {
+      targets.push_back(static_cast<Index>(neighbour));
+      weights.push_back(weight);
+    }
+    offsets[v + 1] = static_cast<int>(targets.size());
+  }
+}
+
+
+// Graph with the same edges as a CSR snapshot
+template <typename T, typename Index>
+Graph<T> toGraph(const CSRGraph<T, Index>& csr,
+                 std::pmr::memory_resource* resource =
+                     std::pmr::get_default_resource()) {
+  Graph<T> G {csr.size(), resource};
+  for (int u = 0; u < csr.size(); ++u) {
+    for (int e = csr.offsets[u]; e < csr.offsets[u + 1]; ++e) {
+      G.addEdge(u, csr.targets[e], csr.weights[e]);
+    }
+  }
+  return G;
+}
+
+// reverse of G: the in-edges of v in the same layout, so row v of the
+// result lists the sources of edges into v, sorted by source
+template <typename T, typename Index>
+CSRGraph<T, Index> transpose(const CSRGraph<T, Index>& G,
+                             std::pmr::memory_resource* resource =
+                                 std::pmr::get_default_resource()) {
+  const int V = G.size();
+  CSRGraph<T, Index> R {V, resource};
+  R.targets.resize(G.numEdges());
+  R.weights.resize(G.numEdges());
+  // counting sort on the edge targets; sources are visited in order, so
+  // each reversed row comes out sorted
+  for (std::size_t e = 0; e < G.numEdges(); ++e) {
+    ++R.offsets[G.targets[e] + 1];
+  }
+  for (int v = 0; v < V; ++v) {
+    R.offsets[v + 1] += R.offsets[v];
+  }
+  std::pmr::vector<int> fill(R.offsets.begin(), R.offsets.end() - 1,
+                             resource);
+  for (int u = 0; u < V; ++u) {
+    for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+      int slot = fill[G.targets[e]]++;
+      R.targets[slot] = static_cast<Index>(u);
+      R.weights[slot] = G.weights[e];
+    }
+  }
+  return R;
+}
+
+// calls visit with a value of the narrowest unsigned type that numbers N
+// vertices, std::uint16_t up to 65536 and std::uint32_t above, and returns
+// what it returns; visit picks its CSRGraph index type from it
+template <typename Visit>
+decltype(auto) withVertexIndex(int N, Visit&& visit) {
+  if (N <= 65536) {
+    return visit(std::uint16_t {});
+  }
+  return visit(std::uint32_t {});
+}
+
+// Bump allocator for per-source scratch space
+// deallocate is a no-op; reset() rewinds to the start of the block so the
+// next source reuses the same memory. Allocations that overflow the block
+// go to the upstream resource and the block grows to fit them on reset()
+class ScratchArena : public std::pmr::memory_resource {
+ private:
+  std::pmr::memory_resource* upstream {};
+  std::byte* block {};
+  std::size_t capacity {};
+  std::size_t used {};
+  std::size_t overflowBytes {};
+  std::vector<std::pair<void*, std::pair<std::size_t, std::size_t> > >
+      overflow {};
+
+  static constexpr std::size_t kBlockAlignment = alignof(std::max_align_t);
+
+  void releaseOverflow() {
+    for (const auto& [p, sizeAndAlign] : overflow) {
+      upstream->deallocate(p, sizeAndAlign.first, sizeAndAlign.second);
+    }
+    overflow.clear();
+  }
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    std::size_t start = (used + alignment - 1) & ~(alignment - 1);
+    if (block and alignment <= kBlockAlignment and
+        start + bytes <= capacity) {
+      used = start + bytes;
+      return block + start;
+    }
+    void* p = upstream->allocate(bytes, alignment);
+    overflow.push_back({p, {bytes, alignment}});
+    overflowBytes += bytes + alignment;
+    return p;
+  }
+
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept override {
+    return this == &other;
+  }
+
+ public:
+  explicit ScratchArena(std::size_t initialBytes = 0,
+                        std::pmr::memory_resource* upstreamResource =
+                            std::pmr::get_default_resource())
+      : upstream {upstreamResource} {
+    if (initialBytes > 0) {
+      block = static_cast<std::byte*>(
+          upstream->allocate(initialBytes, kBlockAlignment));
+      capacity = initialBytes;
+    }
+  }
+
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  ~ScratchArena() override {
+    releaseOverflow();
+    if (block) {
+      upstream->deallocate(block, capacity, kBlockAlignment);
+    }
+  }
+
+  // invalidates everything allocated since the last reset
+  void reset() {
+    releaseOverflow();
+    if (overflowBytes > 0) {
+      std::size_t grown = capacity + overflowBytes;
+      if (block) {
+        upstream->deallocate(block, capacity, kBlockAlignment);
+      }
+      block = static_cast<std::byte*>(
+          upstream->allocate(grown, kBlockAlignment));
+      capacity = grown;
+      overflowBytes = 0;
+    }
+    used = 0;
+  }
+
+  std::size_t blockSize() const {
+    return capacity;
+  }
+};
+
+
+// Hot-path instrumentation
+// counters are only maintained when GRAPH_ENABLE_STATS is defined before
+// this header is included; otherwise every update compiles away
+#ifdef GRAPH_ENABLE_STATS
+inline constexpr bool kStatsEnabled = true;
+#else
+inline constexpr bool kStatsEnabled = false;
+#endif
+
+struct APSPStats {
+  std::uint64_t edgeRelaxations {};
+  std::uint64_t successfulRelaxations {};
+  std::uint64_t heapPushes {};
+  std::uint64_t heapPops {};
+  std::uint64_t bellmanFordPasses {};
+  // vertices whose distance came from a finished row and which were
+  // therefore never scanned (APSPOptions::reuseFinishedRows)
+  std::uint64_t boundedVertices {};
+  // load is building the engine's copy of the graph, reweight is
+  // Bellman-Ford plus reweighting; dijkstra and unreweight are summed
+  // over workers, so they are wall times only for a single worker
+  std::chrono::nanoseconds loadTime {};
+  std::chrono::nanoseconds reweightTime {};
+  std::chrono::nanoseconds dijkstraTime {};
+  std::chrono::nanoseconds unreweightTime {};
+
+  APSPStats& operator+=(const APSPStats& other) {
+    edgeRelaxations += other.edgeRelaxations;
+    successfulRelaxations += other.successfulRelaxations;
+    heapPushes += other.heapPushes;
+    heapPops += other.heapPops;
+    bellmanFordPasses += other.bellmanFordPasses;
+    boundedVertices += other.boundedVertices;
+    loadTime += other.loadTime;
+    reweightTime += other.reweightTime;
+    dijkstraTime += other.dijkstraTime;
+    unreweightTime += other.unreweightTime;
+    return *this;
+  }
+
+  // calls visit(name, value) for every counter, timings in nanoseconds,
+  // for exporting to a metrics system
+  template <typename Visitor>
+  void forEach(Visitor&& visit) const {
+    visit("edge_relaxations", edgeRelaxations);
+    visit("successful_relaxations", successfulRelaxations);
+    visit("heap_pushes", heapPushes);
+    visit("heap_pops", heapPops);
+    visit("bellman_ford_passes", bellmanFordPasses);
+    visit("bounded_vertices", boundedVertices);
+    visit("load_ns", static_cast<std::uint64_t>(loadTime.count()));
+    visit("reweight_ns", static_cast<std::uint64_t>(reweightTime.count()));
+    visit("dijkstra_ns", static_cast<std::uint64_t>(dijkstraTime.count()));
+    visit("unreweight_ns",
+          static_cast<std::uint64_t>(unreweightTime.count()));
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const APSPStats& stats) {
+  stats.forEach([&out](const char* name, std::uint64_t value) {
+    out << name << ' ' << value << '\n';
+  });
+  return out;
+}
+
+// adds the lifetime of the timer to *target when stats are compiled in
+class PhaseTimer {
+ private:
+  std::chrono::nanoseconds* target {};
+  std::chrono::steady_clock::time_point start {};
+
+ public:
+  explicit PhaseTimer(std::chrono::nanoseconds* phase) : target {phase} {
+    if constexpr (kStatsEnabled) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  ~PhaseTimer() {
+    stop();
+  }
+
+  // records the elapsed time now instead of at scope exit
+  void stop() {
+    if constexpr (kStatsEnabled) {
+      if (target) {
+        *target += std::chrono::steady_clock::now() - start;
+        target = nullptr;
+      }
+    }
+  }
+};
+
+
 // APSP functions
 // Use this function to return an "infinity" value
 // appropriate for the type T
 template <typename T>
-T infinity() {
+constexpr T infinity() {
   if (std::numeric_limits<T>::has_infinity) {
     return std::numeric_limits<T>::infinity();
   } else {
@@ -128,28 +573,1176 @@ T infinity() {
   }
 }
 
-// implement an algorithm for determining if G
-// has a negative weight cycle here
+// polymorphic_allocator whose value-less construct default-initialises,
+// so resizing a vector of trivial T leaves the new entries unwritten
+template <typename T>
+class DefaultInitAllocator : public std::pmr::polymorphic_allocator<T> {
+ public:
+  using std::pmr::polymorphic_allocator<T>::polymorphic_allocator;
+  using std::pmr::polymorphic_allocator<T>::construct;
+
+  DefaultInitAllocator(const std::pmr::polymorphic_allocator<T>& other)
+      : std::pmr::polymorphic_allocator<T>(other) {}
+
+  template <typename U>
+  void construct(U* p) {
+    ::new (static_cast<void*>(p)) U;
+  }
+};
+
+// Dense V x V distance matrix stored row-major in one allocation
+// entry (i, j) is the distance from i to j, infinity<T>() if unreachable
 template <typename T>
-bool existsNegativeCycle(const Graph<T>& G) {
-  std::ignore = G;
+class DistanceMatrix {
+ private:
+  std::vector<T, DefaultInitAllocator<T> > entries {};
+  int numVertices {};
+
+  struct Unwritten {};
+
+  DistanceMatrix(Unwritten, int N, std::pmr::memory_resource* resource)
+      : entries(DefaultInitAllocator<T> {resource}), numVertices {N} {
+    entries.resize(static_cast<std::size_t>(N) * N);
+  }
+
+ public:
+  DistanceMatrix() = default;
+
+  // N x N matrix whose entries are left unwritten for the caller to fill,
+  // so each page is first touched by whichever thread fills it
+  static DistanceMatrix uninitialized(int N,
+                                      std::pmr::memory_resource* resource =
+                                          std::pmr::get_default_resource()) {
+    return DistanceMatrix {Unwritten {}, N, resource};
+  }
+
+  // N x N matrix with every entry set to fill, allocated from resource
+  // (a HugePageResource puts a large one on huge pages)
+  explicit DistanceMatrix(int N, T fill = infinity<T>(),
+                          std::pmr::memory_resource* resource =
+                              std::pmr::get_default_resource())
+      : entries(static_cast<std::size_t>(N) * N, fill,
+                DefaultInitAllocator<T> {resource}),
+        numVertices {N} {}
+
+  // copy of a row-per-vertex matrix such as johnsonAPSP returns
+  explicit DistanceMatrix(const std::vector<std::vector<T> >& rows,
+                          std::pmr::memory_resource* resource =
+                              std::pmr::get_default_resource())
+      : DistanceMatrix(static_cast<int>(rows.size()), infinity<T>(),
+                       resource) {
+    for (int i = 0; i < numVertices; ++i) {
+      if (static_cast<int>(rows[i].size()) != numVertices) {
+        throw std::invalid_argument("distance matrix must be square");
+      }
+      std::copy(rows[i].begin(), rows[i].end(), row(i));
+    }
+  }
+
+  int size() const {
+    return numVertices;
+  }
+
+  bool empty() const {
+    return numVertices == 0;
+  }
+
+  T& operator()(int i, int j) {
+    return entries[static_cast<std::size_t>(i) * numVertices + j];
+  }
+
+  const T& operator()(int i, int j) const {
+    return entries[static_cast<std::size_t>(i) * numVertices + j];
+  }
+
+  T* row(int i) {
+    return entries.data() + static_cast<std::size_t>(i) * numVertices;
+  }
+
+  const T* row(int i) const {
+    return entries.data() + static_cast<std::size_t>(i) * numVertices;
+  }
+
+  // row-per-vertex copy, the shape the APSP functions return
+  std::vector<std::vector<T> > toRows() const {
+    std::vector<std::vector<T> > rows(numVertices);
+    for (int i = 0; i < numVertices; ++i) {
+      rows[i].assign(row(i), row(i) + numVertices);
+    }
+    return rows;
+  }
+
+  bool operator==(const DistanceMatrix& other) const = default;
+};
+
+// one-hop distances of G: 0 on the diagonal, the edge weight where there
+// is an edge and infinity elsewhere
+template <typename T>
+DistanceMatrix<T> adjacencyMatrix(const Graph<T>& G,
+                                  std::pmr::memory_resource* resource =
+                                      std::pmr::get_default_resource()) {
+  DistanceMatrix<T> D {G.size(), infinity<T>(), resource};
+  for (int i = 0; i < G.size(); ++i) {
+    D(i, i) = T {};
+    for (const auto& [j, weight] : G.neighbours(i)) {
+      D(i, j) = std::min(D(i, j), weight);
+    }
+  }
+  return D;
+}
+
+// tuning knobs shared by the APSP engines
+struct APSPOptions {
+  // internal structures (CSR copies, potentials, per-worker scratch
+  // arenas) are allocated from here; the returned matrix is not.
+  // Workers share it, so it must be thread-safe when numThreads != 1
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+  // worker threads; 0 means std::thread::hardware_concurrency()
+  unsigned numThreads = 0;
+  // if set and GRAPH_ENABLE_STATS is defined, counters for the run are
+  // added to *stats
+  APSPStats* stats = nullptr;
+  // sources Johnson searches together in one pass over the edges: 1 runs
+  // plain Dijkstra per source, 8 or 16 use batchedDijkstra
+  int sourceBatch = 1;
+  // cooperative cancellation, polled before each source batch (Johnson)
+  // or k iteration (Floyd-Warshall). A cancelled run returns V rows of
+  // which only the finished ones are non-empty
+  std::stop_token stopToken {};
+  // if set, advanced as work finishes: by one per source for Johnson and
+  // per k iteration for Floyd-Warshall, V in total
+  std::atomic<int>* progress = nullptr;
+  // pin worker i of n to NUMA node i * nodes / n and give each node its
+  // own copy of the graph; no effect on a single-node machine
+  bool numaAware = false;
+  // Johnson only, with sourceBatch 1: search sources in depth-first
+  // postorder and let each search take d(s, u) + d(u, t) as an upper
+  // bound on d(s, t) for every finished row u it reaches, so the vertices
+  // that bound covers are never scanned
+  bool reuseFinishedRows = false;
+};
+
+// can the AVX2 kernels run on this CPU?
+inline bool cpuHasAVX2() {
+#if defined(__AVX2__)
   return true;
+#elif defined(GRAPH_AVX2)
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// rows of work below which adding another thread is not worth spawning it
+inline constexpr int kMinRowsPerWorker = 32;
+
+// number of workers to use for rows units of work
+inline unsigned workerCount(unsigned requested, int rows) {
+  unsigned workers = requested;
+  if (workers == 0) {
+    workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  unsigned useful = static_cast<unsigned>(
+      std::max(1, (rows + kMinRowsPerWorker - 1) / kMinRowsPerWorker));
+  return std::min(workers, useful);
+}
+
+// the contiguous block [first, last) of rows worker id of workers owns
+inline std::pair<int, int> workerRows(int rows, unsigned id,
+                                      unsigned workers) {
+  return {static_cast<int>(static_cast<long long>(rows) * id / workers),
+          static_cast<int>(static_cast<long long>(rows) * (id + 1) / workers)};
+}
+
+// runs worker(id) for id in [0, numWorkers) with worker 0 on the calling
+// thread, and rethrows the first exception any of them raised
+template <typename Worker>
+void runWorkers(unsigned numWorkers, Worker&& worker) {
+  std::exception_ptr failure {};
+  std::mutex failureMutex {};
+  auto guarded = [&](unsigned id) {
+    try {
+      worker(id);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock {failureMutex};
+      if (!failure) {
+        failure = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads {};
+  threads.reserve(numWorkers > 0 ? numWorkers - 1 : 0);
+  for (unsigned id = 1; id < numWorkers; ++id) {
+    threads.emplace_back(guarded, id);
+  }
+  guarded(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+// counts[0, n) becomes its exclusive prefix sum, with the total stored in
+// counts[n]; counts must hold n + 1 entries. Each worker sums a block,
+// the block totals are scanned, then each worker scans its block again
+// from its block's start
+inline void parallelPrefixSum(std::pmr::vector<int>& counts, int n,
+                              unsigned numThreads) {
+  unsigned workers = workerCount(numThreads, n / 4096);
+  std::vector<long long> blockTotal(workers + 1, 0);
+  runWorkers(workers, [&](unsigned id) {
+    auto [first, last] = workerRows(n, id, workers);
+    long long sum = 0;
+    for (int v = first; v < last; ++v) {
+      sum += counts[v];
+    }
+    blockTotal[id + 1] = sum;
+  });
+  for (unsigned id = 0; id < workers; ++id) {
+    blockTotal[id + 1] += blockTotal[id];
+  }
+  if (blockTotal[workers] > std::numeric_limits<int>::max()) {
+    throw std::length_error("too many edges for int offsets");
+  }
+  runWorkers(workers, [&](unsigned id) {
+    auto [first, last] = workerRows(n, id, workers);
+    int sum = static_cast<int>(blockTotal[id]);
+    for (int v = first; v < last; ++v) {
+      int count = counts[v];
+      counts[v] = sum;
+      sum += count;
+    }
+  });
+  counts[n] = static_cast<int>(blockTotal[workers]);
+}
+
+// parallel counting sort of the edges on their targets: workers count
+// in-degrees, parallelPrefixSum turns them into offsets, and workers
+// scatter chunks of sources through atomic_ref cursors. With one worker
+// sources are scattered in increasing order, so rows come out sorted by
+// source; with more, each row is then sorted
+template <typename T>
+void Graph<T>::buildInEdges(unsigned numThreads) const {
+  const int V = numVertices;
+  InEdgeCache& cache = inEdgeCache;
+  std::pmr::vector<int>& offsets = cache.offsets.emplace(V + 1, 0,
+                                                         resource());
+  const unsigned workers = workerCount(numThreads, V);
+  std::atomic<int> next {0};
+  // sources are handed out in chunks, so the workers share few counters
+  constexpr int chunk = 256;
+  auto forChunks = [&](auto&& visit) {
+    next = 0;
+    runWorkers(workers, [&](unsigned) {
+      for (int first = next.fetch_add(chunk); first < V;
+           first = next.fetch_add(chunk)) {
+        for (int u = first; u < std::min(V, first + chunk); ++u) {
+          visit(u);
+        }
+      }
+    });
+  };
+  forChunks([&](int u) {
+    for (const auto& [v, weight] : adjList[u]) {
+      std::atomic_ref<int> {offsets[v]}.fetch_add(1,
+                                                  std::memory_order_relaxed);
+    }
+  });
+  parallelPrefixSum(offsets, V, numThreads);
+  std::pmr::vector<InEdge>& edges = cache.edges.emplace(offsets[V],
+                                                        resource());
+  std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+  forChunks([&](int u) {
+    for (const auto& [v, weight] : adjList[u]) {
+      int slot = std::atomic_ref<int> {fill[v]}.fetch_add(
+          1, std::memory_order_relaxed);
+      edges[slot] = {u, weight};
+    }
+  });
+  if (workers > 1) {
+    forChunks([&](int v) {
+      std::sort(edges.begin() + offsets[v], edges.begin() + offsets[v + 1],
+                [](const InEdge& a, const InEdge& b) {
+                  return a.first < b.first;
+                });
+    });
+  }
+}
+
+template <typename T>
+std::span<const typename Graph<T>::InEdge> Graph<T>::inNeighbours(
+    int a, unsigned numThreads) const {
+  if (a < 0 or a >= numVertices) {
+    throw std::out_of_range("invalid vertex number");
+  }
+  if (!inEdgeCache.valid.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock {inEdgeCache.mutex};
+    if (!inEdgeCache.valid.load(std::memory_order_relaxed)) {
+      buildInEdges(numThreads);
+      inEdgeCache.valid.store(true, std::memory_order_release);
+    }
+  }
+  const InEdge* row = inEdgeCache.edges->data();
+  const std::pmr::vector<int>& offsets = *inEdgeCache.offsets;
+  return {row + offsets[a], row + offsets[a + 1]};
+}
+
+// Bellman-Ford from a virtual source joined to every vertex by a 0 edge
+// leaves the shortest distances from it in potential (which must hold V
+// zeros) and returns false if G has a negative weight cycle
+template <typename T, typename Index>
+bool bellmanFordPotentials(const CSRGraph<T, Index>& G,
+                           std::pmr::vector<T>& potential,
+                           APSPStats* stats = nullptr) {
+  int V = G.size();
+  std::uint64_t passes {};
+  std::uint64_t relaxations {};
+  std::uint64_t improved {};
+  auto record = [&]() {
+    if constexpr (kStatsEnabled) {
+      if (stats) {
+        stats->bellmanFordPasses += passes;
+        stats->edgeRelaxations += relaxations;
+        stats->successfulRelaxations += improved;
+      }
+    }
+  };
+  // shortest paths from the virtual source use at most V edges, one of
+  // which is the 0 edge already accounted for, so pass V must be quiet
+  for (int pass = 0; pass < V; ++pass) {
+    bool changed = false;
+    for (int u = 0; u < V; ++u) {
+      T du = potential[u];
+      for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+        T viaU = du + G.weights[e];
+        if (viaU < potential[G.targets[e]]) {
+          potential[G.targets[e]] = viaU;
+          changed = true;
+          if constexpr (kStatsEnabled) {
+            ++improved;
+          }
+        }
+      }
+    }
+    if constexpr (kStatsEnabled) {
+      ++passes;
+      relaxations += G.numEdges();
+    }
+    if (!changed) {
+      record();
+      return true;
+    }
+  }
+  record();
+  return false;
+}
+
+// Dijkstra from source over non-negative weights, leaving distances in
+// dist; the heap is allocated from scratch
+template <typename T, typename Index>
+void dijkstra(const CSRGraph<T, Index>& G, int source,
+              std::pmr::vector<T>& dist, std::pmr::memory_resource* scratch,
+              APSPStats* stats = nullptr) {
+  using Entry = std::pair<T, int>;
+  const T inf = infinity<T>();
+  std::uint64_t relaxations {};
+  std::uint64_t improved {};
+  std::uint64_t pops {};
+  dist.assign(G.size(), inf);
+  std::pmr::vector<Entry> heap(scratch);
+  heap.reserve(G.size());
+  dist[source] = T {};
+  heap.push_back({T {}, source});
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+    auto [du, u] = heap.back();
+    heap.pop_back();
+    if constexpr (kStatsEnabled) {
+      ++pops;
+    }
+    if (dist[u] < du) {
+      continue;
+    }
+    for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+      int v = G.targets[e];
+      T viaU = du + G.weights[e];
+      if constexpr (kStatsEnabled) {
+        ++relaxations;
+      }
+      if (viaU < dist[v]) {
+        dist[v] = viaU;
+        heap.push_back({viaU, v});
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+        if constexpr (kStatsEnabled) {
+          ++improved;
+        }
+      }
+    }
+  }
+  if constexpr (kStatsEnabled) {
+    if (stats) {
+      stats->edgeRelaxations += relaxations;
+      stats->successfulRelaxations += improved;
+      // every successful relaxation pushes, plus the source
+      stats->heapPushes += improved + 1;
+      stats->heapPops += pops;
+    }
+  }
+}
+
+// every vertex of G in breadth-first order along out-edges, restarting
+// from the lowest unvisited vertex whenever the queue runs dry
+template <typename T, typename Index>
+std::pmr::vector<int> breadthFirstOrder(const CSRGraph<T, Index>& G,
+                                        std::pmr::memory_resource* resource) {
+  const int V = G.size();
+  std::pmr::vector<int> order(resource);
+  std::pmr::vector<char> seen(V, 0, resource);
+  order.reserve(V);
+  for (int root = 0; root < V; ++root) {
+    if (seen[root]) {
+      continue;
+    }
+    seen[root] = 1;
+    // order doubles as the queue: [head, order.size()) is still to visit
+    std::size_t head = order.size();
+    order.push_back(root);
+    for (; head < order.size(); ++head) {
+      int u = order[head];
+      for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+        if (!seen[G.targets[e]]) {
+          seen[G.targets[e]] = 1;
+          order.push_back(G.targets[e]);
+        }
+      }
+    }
+  }
+  return order;
+}
+
+// every vertex of G in depth-first postorder along out-edges, restarting
+// from the lowest unvisited vertex, so a vertex comes after everything it
+// reaches that was not already on the stack
+template <typename T, typename Index>
+std::pmr::vector<int> depthFirstPostOrder(
+    const CSRGraph<T, Index>& G, std::pmr::memory_resource* resource) {
+  const int V = G.size();
+  std::pmr::vector<int> order(resource);
+  std::pmr::vector<char> seen(V, 0, resource);
+  // (vertex, next edge to follow) for every vertex on the current path
+  std::pmr::vector<std::pair<int, int> > stack(resource);
+  order.reserve(V);
+  for (int root = 0; root < V; ++root) {
+    if (seen[root]) {
+      continue;
+    }
+    seen[root] = 1;
+    stack.push_back({root, G.offsets[root]});
+    while (!stack.empty()) {
+      auto& [u, e] = stack.back();
+      if (e == G.offsets[u + 1]) {
+        order.push_back(u);
+        stack.pop_back();
+        continue;
+      }
+      int v = G.targets[e++];
+      if (!seen[v]) {
+        seen[v] = 1;
+        stack.push_back({v, G.offsets[v]});
+      }
+    }
+  }
+  return order;
+}
+
+// Dijkstra from source over the reweighted graph G that reuses the
+// finished rows of result, which hold original distances under
+// potential. When a vertex u whose row is finished is settled, every t
+// gets d(s, u) + d(u, t) as an upper bound and u is not scanned, since
+// the row already accounts for every path through it. A vertex whose
+// final distance is such a bound is never queued or scanned either: any
+// path through it is no shorter than the bound the same row gives. Rows
+// are read only once finished[u], read with acquire, is set
+template <typename T, typename Index>
+void boundedDijkstra(const CSRGraph<T, Index>& G, int source,
+                     const std::pmr::vector<T>& potential,
+                     const std::vector<std::vector<T> >& result,
+                     std::pmr::vector<char>& finished,
+                     std::pmr::vector<T>& dist,
+                     std::pmr::memory_resource* scratch,
+                     APSPStats* stats = nullptr) {
+  using Entry = std::pair<T, int>;
+  const T inf = infinity<T>();
+  const int V = G.size();
+  std::uint64_t relaxations {};
+  std::uint64_t improved {};
+  std::uint64_t pops {};
+  std::uint64_t bounded {};
+  dist.assign(V, inf);
+  // is dist[v] a bound from a finished row rather than a relaxed edge?
+  std::pmr::vector<char> fromRow(V, 0, scratch);
+  std::pmr::vector<Entry> heap(scratch);
+  heap.reserve(V);
+  dist[source] = T {};
+  heap.push_back({T {}, source});
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+    auto [du, u] = heap.back();
+    heap.pop_back();
+    if constexpr (kStatsEnabled) {
+      ++pops;
+    }
+    if (dist[u] < du) {
+      continue;
+    }
+    if (u != source and
+        std::atomic_ref<char> {finished[u]}.load(std::memory_order_acquire)) {
+      // reweighted d(s, t) <= du + d(u, t) + h(u) - h(t)
+      const std::vector<T>& row = result[u];
+      const T base = du + potential[u];
+      for (int t = 0; t < V; ++t) {
+        if (row[t] == inf) {
+          continue;
+        }
+        T bound = base + row[t] - potential[t];
+        if (bound < dist[t]) {
+          dist[t] = bound;
+          fromRow[t] = 1;
+        }
+      }
+      continue;
+    }
+    for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+      int v = G.targets[e];
+      T viaU = du + G.weights[e];
+      if constexpr (kStatsEnabled) {
+        ++relaxations;
+      }
+      if (viaU < dist[v]) {
+        dist[v] = viaU;
+        fromRow[v] = 0;
+        heap.push_back({viaU, v});
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+        if constexpr (kStatsEnabled) {
+          ++improved;
+        }
+      }
+    }
+  }
+  if constexpr (kStatsEnabled) {
+    if (stats) {
+      for (int t = 0; t < V; ++t) {
+        bounded += fromRow[t];
+      }
+      stats->edgeRelaxations += relaxations;
+      stats->successfulRelaxations += improved;
+      stats->heapPushes += improved + 1;
+      stats->heapPops += pops;
+      stats->boundedVertices += bounded;
+    }
+  }
+}
+
+// smallest of Batch values, a power of two, by halving: each pass is an
+// elementwise min of two halves. lanes is overwritten
+template <int Batch, typename T>
+T smallestLane(T* lanes) {
+  for (int half = Batch / 2; half > 0; half /= 2) {
+    for (int b = 0; b < half; ++b) {
+      lanes[b] = lanes[b + half] < lanes[b] ? lanes[b + half] : lanes[b];
+    }
+  }
+  return lanes[0];
+}
+
+// lane operations for relaxLanes; Lanes == 0 means no SIMD path
+template <typename T>
+struct BatchLanes {
+  static constexpr int Lanes = 0;
+};
+
+#ifdef GRAPH_AVX2
+template <>
+struct BatchLanes<int> {
+  static constexpr int Lanes = 8;
+  using Vec = __m256i;
+  GRAPH_AVX2_TARGET static Vec load(const int* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  GRAPH_AVX2_TARGET static void store(int* p, Vec v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  GRAPH_AVX2_TARGET static Vec broadcast(int a) {
+    return _mm256_set1_epi32(a);
+  }
+  GRAPH_AVX2_TARGET static Vec add(Vec a, Vec b) {
+    return _mm256_add_epi32(a, b);
+  }
+  GRAPH_AVX2_TARGET static Vec min(Vec a, Vec b) {
+    return _mm256_min_epi32(a, b);
+  }
+  // all ones in the lanes where a < b
+  GRAPH_AVX2_TARGET static Vec less(Vec a, Vec b) {
+    return _mm256_cmpgt_epi32(b, a);
+  }
+  // a where mask is set, b elsewhere
+  GRAPH_AVX2_TARGET static Vec select(Vec mask, Vec a, Vec b) {
+    return _mm256_blendv_epi8(b, a, mask);
+  }
+};
+
+template <>
+struct BatchLanes<float> {
+  static constexpr int Lanes = 8;
+  using Vec = __m256;
+  GRAPH_AVX2_TARGET static Vec load(const float* p) {
+    return _mm256_loadu_ps(p);
+  }
+  GRAPH_AVX2_TARGET static void store(float* p, Vec v) {
+    _mm256_storeu_ps(p, v);
+  }
+  GRAPH_AVX2_TARGET static Vec broadcast(float a) {
+    return _mm256_set1_ps(a);
+  }
+  GRAPH_AVX2_TARGET static Vec add(Vec a, Vec b) {
+    return _mm256_add_ps(a, b);
+  }
+  GRAPH_AVX2_TARGET static Vec min(Vec a, Vec b) {
+    return _mm256_min_ps(a, b);
+  }
+  GRAPH_AVX2_TARGET static Vec less(Vec a, Vec b) {
+    return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+  }
+  GRAPH_AVX2_TARGET static Vec select(Vec mask, Vec a, Vec b) {
+    return _mm256_blendv_ps(b, a, mask);
+  }
+};
+
+template <>
+struct BatchLanes<double> {
+  static constexpr int Lanes = 4;
+  using Vec = __m256d;
+  GRAPH_AVX2_TARGET static Vec load(const double* p) {
+    return _mm256_loadu_pd(p);
+  }
+  GRAPH_AVX2_TARGET static void store(double* p, Vec v) {
+    _mm256_storeu_pd(p, v);
+  }
+  GRAPH_AVX2_TARGET static Vec broadcast(double a) {
+    return _mm256_set1_pd(a);
+  }
+  GRAPH_AVX2_TARGET static Vec add(Vec a, Vec b) {
+    return _mm256_add_pd(a, b);
+  }
+  GRAPH_AVX2_TARGET static Vec min(Vec a, Vec b) {
+    return _mm256_min_pd(a, b);
+  }
+  GRAPH_AVX2_TARGET static Vec less(Vec a, Vec b) {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+  }
+  GRAPH_AVX2_TARGET static Vec select(Vec mask, Vec a, Vec b) {
+    return _mm256_blendv_pd(b, a, mask);
+  }
+};
+
+// relaxLanes with BatchLanes<T>, Lanes::Lanes lanes per instruction
+template <int Batch, typename T>
+GRAPH_AVX2_TARGET T relaxLanesAVX2(const T* du, T w, T* dv) {
+  using Lanes = BatchLanes<T>;
+  using Vec = typename Lanes::Vec;
+  static_assert(Batch % Lanes::Lanes == 0);
+  const T inf = infinity<T>();
+  const Vec cap = Lanes::broadcast(inf - w);
+  const Vec weight = Lanes::broadcast(w);
+  const Vec infinite = Lanes::broadcast(inf);
+  Vec smallest = infinite;
+  for (int b = 0; b < Batch; b += Lanes::Lanes) {
+    Vec viaU = Lanes::add(Lanes::min(Lanes::load(du + b), cap), weight);
+    Vec old = Lanes::load(dv + b);
+    Vec improves = Lanes::less(viaU, old);
+    Lanes::store(dv + b, Lanes::min(viaU, old));
+    smallest = Lanes::min(smallest, Lanes::select(improves, viaU, infinite));
+  }
+  T lanes[Lanes::Lanes];
+  Lanes::store(lanes, smallest);
+  return smallestLane<Lanes::Lanes>(lanes);
+}
+#endif
+
+// lowers each lane dv[b] to du[b] + w over an edge of weight w >= 0 and
+// returns the smallest lane that improved, or inf if none did. Clamping
+// du to inf - w makes du + w saturate at inf instead of overflowing, so
+// infinite lanes need no branch; with vector set, int, float and double
+// use AVX2 lanes
+template <int Batch, typename T>
+T relaxLanes(const T* du, T w, T* dv, bool vector) {
+#ifdef GRAPH_AVX2
+  if constexpr (BatchLanes<T>::Lanes != 0) {
+    if (vector) {
+      return relaxLanesAVX2<Batch>(du, w, dv);
+    }
+  }
+#endif
+  (void)vector;
+  const T inf = infinity<T>();
+  const T cap = inf - w;
+  // the lanes that improve, with inf for the others
+  T improvedLanes[Batch];
+  for (int b = 0; b < Batch; ++b) {
+    T viaU = (du[b] < cap ? du[b] : cap) + w;
+    bool improves = viaU < dv[b];
+    improvedLanes[b] = improves ? viaU : inf;
+    dv[b] = improves ? viaU : dv[b];
+  }
+  return smallestLane<Batch>(improvedLanes);
+}
+
+// Label-correcting search from Batch sources at once over non-negative
+// weights. dist is laid out source-interleaved, dist[v * Batch + b] being
+// the distance from sources[b] to v, so relaxing an edge is one
+// relaxLanes over a contiguous run of Batch values: two or four AVX2
+// vectors where the CPU has AVX2.
+// A vertex is queued with the smallest of the lanes that just improved
+// and re-queued whenever a lane improves again, which tolerates settling
+// out of order.
+// Lanes past count are unused and stay at infinity
+template <int Batch, typename T, typename Index>
+void batchedDijkstra(const CSRGraph<T, Index>& G, const int* sources,
+                     int count, std::pmr::vector<T>& dist,
+                     std::pmr::memory_resource* scratch,
+                     APSPStats* stats = nullptr) {
+  using Entry = std::pair<T, int>;
+  const T inf = infinity<T>();
+  const int V = G.size();
+  std::uint64_t scans {};
+  std::uint64_t improved {};
+  std::uint64_t pushes {};
+  std::uint64_t pops {};
+  dist.assign(static_cast<std::size_t>(V) * Batch, inf);
+  const bool vector = cpuHasAVX2();
+  std::pmr::vector<char> queued(V, 0, scratch);
+  std::pmr::vector<Entry> heap(scratch);
+  heap.reserve(V);
+  for (int b = 0; b < count; ++b) {
+    dist[static_cast<std::size_t>(sources[b]) * Batch + b] = T {};
+    if (!queued[sources[b]]) {
+      queued[sources[b]] = 1;
+      heap.push_back({T {}, sources[b]});
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+    int u = heap.back().second;
+    heap.pop_back();
+    if constexpr (kStatsEnabled) {
+      ++pops;
+    }
+    // a vertex can be in the heap more than once; only the first pop
+    // after it was queued scans it
+    if (!queued[u]) {
+      continue;
+    }
+    queued[u] = 0;
+    // private copy so the lane loops below cannot alias dv
+    T du[Batch];
+    std::copy_n(dist.data() + static_cast<std::size_t>(u) * Batch, Batch, du);
+    for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+      int v = G.targets[e];
+      T w = G.weights[e];
+      T* dv = dist.data() + static_cast<std::size_t>(v) * Batch;
+      // an improved lane is below inf, so smallest says whether any did
+      T smallest = relaxLanes<Batch>(du, w, dv, vector);
+      if constexpr (kStatsEnabled) {
+        ++scans;
+      }
+      if (smallest != inf) {
+        if constexpr (kStatsEnabled) {
+          ++improved;
+          ++pushes;
+        }
+        queued[v] = 1;
+        heap.push_back({smallest, v});
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+      }
+    }
+  }
+  if constexpr (kStatsEnabled) {
+    if (stats) {
+      stats->edgeRelaxations += scans * Batch;
+      stats->successfulRelaxations += improved;
+      stats->heapPushes += pushes + count;
+      stats->heapPops += pops;
+    }
+  }
+}
+
+// adds a finished run's counters to options.stats
+inline void publishStats(const APSPOptions& options, const APSPStats& local) {
+  if constexpr (kStatsEnabled) {
+    if (options.stats) {
+      *options.stats += local;
+    }
+  }
+}
+
+// does G have a negative weight cycle?
+template <typename T>
+bool existsNegativeCycle(const Graph<T>& G,
+                         const APSPOptions& options = APSPOptions {}) {
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  CSRGraph<T> csr {G, options.resource};
+  std::pmr::vector<T> potential(G.size(), T {}, options.resource);
+  load.stop();
+  PhaseTimer reweight {&local.reweightTime};
+  bool noCycle = bellmanFordPotentials(csr, potential, &local);
+  reweight.stop();
+  publishStats(options, local);
+  return !noCycle;
+}
+
+// does G have a negative weight cycle? Scratch space comes from resource
+template <typename T>
+bool existsNegativeCycle(const Graph<T>& G,
+                         std::pmr::memory_resource* resource) {
+  APSPOptions options {};
+  options.resource = resource;
+  return existsNegativeCycle(G, options);
+}
+
+// w'(u, v) = w(u, v) + h(u) - h(v) >= 0 for potentials h from
+// bellmanFordPotentials
+template <typename T, typename Index>
+void reweightEdges(CSRGraph<T, Index>& G,
+                   const std::pmr::vector<T>& potential) {
+  for (int u = 0; u < G.size(); ++u) {
+    for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+      G.weights[e] += potential[u] - potential[G.targets[e]];
+    }
+  }
+}
+
+// throws std::invalid_argument unless options are valid for Johnson's
+// algorithm; engines call it before doing any work
+inline void checkJohnsonOptions(const APSPOptions& options) {
+  const int batch = options.sourceBatch;
+  if (batch != 1 and batch != 8 and batch != 16) {
+    throw std::invalid_argument("sourceBatch must be 1, 8 or 16");
+  }
+  if (options.reuseFinishedRows and batch != 1) {
+    throw std::invalid_argument("reuseFinishedRows needs sourceBatch 1");
+  }
+}
+
+// the search phase of Johnson's algorithm over a reweighted graph: fills
+// every row of result that is still empty, calling rowDone(s) from the
+// worker that finished row s. Stops early if options.stopToken fires
+template <typename T, typename Index, typename RowDone>
+void johnsonSearchRows(const CSRGraph<T, Index>& reweighted,
+                       const std::pmr::vector<T>& potential,
+                       const APSPOptions& options,
+                       std::vector<std::vector<T> >& result,
+                       APSPStats& local, RowDone&& rowDone) {
+  const int V = reweighted.size();
+  const T inf = infinity<T>();
+  checkJohnsonOptions(options);
+  const int batch = options.sourceBatch;
+  const bool reuse = options.reuseFinishedRows;
+  // batches of nearby sources have similar search orders, so fewer
+  // vertices are re-scanned than with arbitrary batches. Reusing rows
+  // wants the opposite: in postorder a source comes after most of what
+  // it reaches, so its search meets finished rows early
+  std::pmr::vector<int> order =
+      reuse ? depthFirstPostOrder(reweighted, options.resource)
+            : breadthFirstOrder(reweighted, options.resource);
+  std::erase_if(order, [&result](int s) { return !result[s].empty(); });
+  // rows boundedDijkstra may read; set with release once a row is written
+  std::pmr::vector<char> finished(reuse ? V : 0, 0, options.resource);
+  for (int s = 0; reuse and s < V; ++s) {
+    finished[s] = !result[s].empty();
+  }
+  const int pending = static_cast<int>(order.size());
+  if (options.progress) {
+    *options.progress += V - pending;
+  }
+  std::atomic<int> nextSource {0};
+  std::mutex statsMutex {};
+  // enough for the distance array and a heap of V entries, so a typical
+  // source never leaves the arena's block
+  std::size_t arenaBytes =
+      V * (batch * sizeof(T) + sizeof(std::pair<T, int>) + 1) + 256;
+  unsigned workers = workerCount(options.numThreads, pending / batch);
+  // one copy of the graph per node, each written by a thread on that node
+  const NumaTopology& topology = numaTopology();
+  std::vector<std::unique_ptr<CSRGraph<T, Index> > > replicas {};
+  if (options.numaAware and topology.nodes() > 1 and workers > 1) {
+    replicas.resize(topology.nodes());
+    runWorkers(topology.nodes(), [&](unsigned node) {
+      NumaPin pin {static_cast<int>(node)};
+      auto copy = std::make_unique<CSRGraph<T, Index> >(V, options.resource);
+      copy->offsets = reweighted.offsets;
+      copy->targets = reweighted.targets;
+      copy->weights = reweighted.weights;
+      replicas[node] = std::move(copy);
+    });
+  }
+  runWorkers(workers, [&](unsigned id) {
+    int node = topology.nodeOfWorker(id, workers);
+    NumaPin pin {node, options.numaAware};
+    const CSRGraph<T, Index>& graph =
+        replicas.empty() ? reweighted : *replicas[node];
+    ScratchArena arena {arenaBytes, options.resource};
+    APSPStats workerStats {};
+    int sources[16] {};
+    for (int first = nextSource.fetch_add(batch); first < pending;
+         first = nextSource.fetch_add(batch)) {
+      if (options.stopToken.stop_requested()) {
+        break;
+      }
+      int count = std::min(batch, pending - first);
+      for (int b = 0; b < count; ++b) {
+        sources[b] = order[first + b];
+      }
+      arena.reset();
+      std::pmr::vector<T> dist(&arena);
+      PhaseTimer search {&workerStats.dijkstraTime};
+      if (batch == 16) {
+        batchedDijkstra<16>(graph, sources, count, dist, &arena,
+                            &workerStats);
+      } else if (batch == 8) {
+        batchedDijkstra<8>(graph, sources, count, dist, &arena,
+                           &workerStats);
+      } else if (reuse) {
+        boundedDijkstra(graph, sources[0], potential, result, finished, dist,
+                        &arena, &workerStats);
+      } else {
+        dijkstra(graph, sources[0], dist, &arena, &workerStats);
+      }
+      search.stop();
+      PhaseTimer unreweight {&workerStats.unreweightTime};
+      for (int b = 0; b < count; ++b) {
+        int s = sources[b];
+        std::vector<T>& row = result[s];
+        row.resize(V);
+        for (int t = 0; t < V; ++t) {
+          T d = dist[static_cast<std::size_t>(t) * batch + b];
+          row[t] = d == inf ? inf : d - potential[s] + potential[t];
+        }
+      }
+      unreweight.stop();
+      if (reuse) {
+        std::atomic_ref<char> {finished[sources[0]]}.store(
+            1, std::memory_order_release);
+      }
+      for (int b = 0; b < count; ++b) {
+        rowDone(sources[b]);
+      }
+      if (options.progress) {
+        *options.progress += count;
+      }
+    }
+    if constexpr (kStatsEnabled) {
+      std::lock_guard<std::mutex> lock {statsMutex};
+      local += workerStats;
+    }
+  });
+}
+
+// Johnson's algorithm with explicit options
+// returns an empty matrix if G has a negative weight cycle; rows of
+// sources not searched before options.stopToken fired are left empty
+template <typename T>
+std::vector<std::vector<T> >
+johnsonAPSPWithOptions(const Graph<T>& G, const APSPOptions& options) {
+  checkJohnsonOptions(options);
+  const int V = G.size();
+  return withVertexIndex(V, [&](auto index) {
+    using Index = decltype(index);
+    APSPStats local {};
+    PhaseTimer load {&local.loadTime};
+    CSRGraph<T, Index> reweighted {G, options.resource};
+    std::pmr::vector<T> potential(V, T {}, options.resource);
+    load.stop();
+    PhaseTimer reweight {&local.reweightTime};
+    if (!bellmanFordPotentials(reweighted, potential, &local)) {
+      reweight.stop();
+      publishStats(options, local);
+      return std::vector<std::vector<T> > {};
+    }
+    reweightEdges(reweighted, potential);
+    reweight.stop();
+
+    std::vector<std::vector<T> > result(V);
+    johnsonSearchRows(reweighted, potential, options, result, local,
+                      [](int) {});
+    publishStats(options, local);
+    return result;
+  });
+}
+
+// iterations k = firstK, ..., V - 1 of Floyd-Warshall on dist, which must
+// hold the result of the first firstK. afterIteration(k) runs once k is
+// done, while every worker waits at the barrier. Returns the number of
+// iterations done in total, which is below V if options.stopToken fired,
+// or -1 if a negative cycle was found
+template <typename T, typename AfterIteration>
+int floydWarshallIterations(DistanceMatrix<T>& dist, int firstK,
+                            const APSPOptions& options, APSPStats& local,
+                            AfterIteration&& afterIteration) {
+  const int V = dist.size();
+  const T inf = infinity<T>();
+  if (options.progress) {
+    *options.progress += firstK;
+  }
+  // each worker owns a contiguous block of rows. Row k and column k do
+  // not change during iteration k while dist(k, k) >= 0, so workers read
+  // them unsynchronised and only meet at the barrier; if dist(k, k) < 0
+  // the owner of row k would rewrite it, so every worker stops before
+  // the iteration instead, all having read the same value
+  unsigned workers = workerCount(options.numThreads, V);
+  std::atomic<bool> negativeCycle {false};
+  bool stop = false;
+  int iterations = firstK;
+  // the completion function cannot throw, so a failure in afterIteration
+  // is kept and rethrown once the workers are done
+  std::exception_ptr failure {};
+  std::barrier sync {static_cast<std::ptrdiff_t>(workers), [&]() noexcept {
+    ++iterations;
+    if (options.progress) {
+      ++*options.progress;
+    }
+    if (!negativeCycle) {
+      try {
+        afterIteration(iterations - 1);
+      } catch (...) {
+        failure = std::current_exception();
+      }
+    }
+    stop = negativeCycle.load() or failure or
+           (iterations < V and options.stopToken.stop_requested());
+  }};
+  std::mutex statsMutex {};
+  const NumaTopology& topology = numaTopology();
+  runWorkers(workers, [&](unsigned id) {
+    NumaPin pin {topology.nodeOfWorker(id, workers), options.numaAware};
+    auto [first, last] = workerRows(V, id, workers);
+    std::uint64_t relaxations {};
+    std::uint64_t improved {};
+    for (int k = firstK; k < V; ++k) {
+      if (dist(k, k) < T {}) {
+        negativeCycle = true;
+        break;
+      }
+      const T* rowK = dist.row(k);
+      for (int i = first; i < last; ++i) {
+        T dik = dist(i, k);
+        if (dik == inf) {
+          continue;
+        }
+        T* rowI = dist.row(i);
+        for (int j = 0; j < V; ++j) {
+          if (rowK[j] != inf and dik + rowK[j] < rowI[j]) {
+            rowI[j] = dik + rowK[j];
+            if constexpr (kStatsEnabled) {
+              ++improved;
+            }
+          }
+        }
+        if constexpr (kStatsEnabled) {
+          relaxations += V;
+        }
+        if (rowI[i] < T {}) {
+          negativeCycle = true;
+        }
+      }
+      sync.arrive_and_wait();
+      if (stop) {
+        break;
+      }
+    }
+    if constexpr (kStatsEnabled) {
+      std::lock_guard<std::mutex> lock {statsMutex};
+      local.edgeRelaxations += relaxations;
+      local.successfulRelaxations += improved;
+    }
+  });
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+  return negativeCycle ? -1 : iterations;
+}
+
+// V x V working matrix for Floyd-Warshall in one allocation from
+// options.resource, so a HugePageResource backs it with 2 MB pages, with
+// row i filled by fill(i, row). Each row is first written by the worker
+// that owns it in floydWarshallIterations, pinned the same way, so on a
+// NUMA machine the kernel places it on the node of the worker that
+// updates it
+template <typename T, typename Fill>
+DistanceMatrix<T> ownedMatrix(int V, const APSPOptions& options,
+                              Fill&& fill) {
+  DistanceMatrix<T> dist = DistanceMatrix<T>::uninitialized(V,
+                                                            options.resource);
+  unsigned workers = workerCount(options.numThreads, V);
+  const NumaTopology& topology = numaTopology();
+  runWorkers(workers, [&](unsigned id) {
+    NumaPin pin {topology.nodeOfWorker(id, workers), options.numaAware};
+    auto [first, last] = workerRows(V, id, workers);
+    for (int i = first; i < last; ++i) {
+      fill(i, std::span<T> {dist.row(i), static_cast<std::size_t>(V)});
+    }
+  });
+  return dist;
+}
+
+// Floyd-Warshall with explicit options
+// returns an empty matrix if G has a negative weight cycle; no row is
+// final before the last iteration, so a cancelled run returns V empty rows
+template <typename T>
+std::vector<std::vector<T> >
+floydWarshallAPSPWithOptions(const Graph<T>& G, const APSPOptions& options) {
+  const int V = G.size();
+  const T inf = infinity<T>();
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  auto dist = ownedMatrix<T>(V, options, [&](int i, std::span<T> row) {
+    std::fill(row.begin(), row.end(), inf);
+    row[i] = T {};
+    for (const auto& [j, weight] : G.neighbours(i)) {
+      row[j] = std::min(row[j], weight);
+    }
+  });
+  load.stop();
+  int iterations = floydWarshallIterations(dist, 0, options, local,
+                                           [](int) {});
+  publishStats(options, local);
+  if (iterations < 0) {
+    return {};
+  }
+  if (iterations < V) {
+    return std::vector<std::vector<T> >(V);
+  }
+  return dist.toRows();
 }
 
-// implement Johnson's APSP algorithm here
+// Johnson's APSP algorithm
+// returns an empty matrix if G has a negative weight cycle
 template <typename T>
 std::vector<std::vector<T> >
 johnsonAPSP(const Graph<T>& G) {
-  std::ignore = G;
-  return {};
+  return johnsonAPSPWithOptions(G, APSPOptions {});
 }
 
-// implement the Floyd-Warshall APSP algorithm here
+// the Floyd-Warshall APSP algorithm
+// returns an empty matrix if G has a negative weight cycle
 template <typename T>
 std::vector<std::vector<T> >
 floydWarshallAPSP(const Graph<T>& G) {
-  std::ignore = G;
-  return {};
+  return floydWarshallAPSPWithOptions(G, APSPOptions {});
 }
 
 #endif      // GRAPH_HPP_
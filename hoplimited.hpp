@@ -0,0 +1,188 @@
+#ifndef HOPLIMITED_HPP_
+#define HOPLIMITED_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <stdexcept>
+#include <vector>
+#include "graph.hpp"
+
+// Hop-limited shortest paths
+// entry t of the result for source s is the weight of the lightest walk
+// from s to t that uses at most k edges (infinity<T>() if none exists).
+// Both functions run k rounds of Bellman-Ford relaxation in Jacobi form:
+// round r reads only the distances of round r - 1, which is what makes the
+// hop bound exact, and they stop early once a round changes nothing.
+// Walks may repeat vertices, so the answers stay well defined when G has
+// negative cycles.
+
+// k-hop distances from source
+// each round pulls over the in-edges of a block of vertices per worker,
+// so no two workers write the same entry
+template <typename T>
+std::vector<T> boundedHopSSSP(const Graph<T>& G, int source, int k,
+                              const APSPOptions& options = APSPOptions {}) {
+  const int V = G.size();
+  const T inf = infinity<T>();
+  if (source < 0 or source >= V) {
+    throw std::out_of_range("invalid vertex number");
+  }
+  if (k < 0) {
+    throw std::invalid_argument("hop limit must be non-negative");
+  }
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  CSRGraph<T> reverse = transpose(CSRGraph<T> {G, options.resource},
+                                  options.resource);
+  load.stop();
+  std::vector<T> current(V, inf);
+  std::vector<T> next(V, inf);
+  current[source] = T {};
+
+  unsigned workers = workerCount(options.numThreads, V);
+  std::atomic<bool> changed {false};
+  int round = 0;
+  bool stop = k == 0;
+  std::barrier sync {static_cast<std::ptrdiff_t>(workers), [&]() noexcept {
+    std::swap(current, next);
+    ++round;
+    stop = !changed.load() or round == k;
+    changed = false;
+  }};
+  std::atomic<std::uint64_t> relaxations {0};
+  runWorkers(workers, [&](unsigned id) {
+    int first = static_cast<int>(static_cast<long long>(V) * id / workers);
+    int last = static_cast<int>(static_cast<long long>(V) * (id + 1) / workers);
+    std::uint64_t scanned {};
+    while (!stop) {
+      bool any = false;
+      for (int v = first; v < last; ++v) {
+        T best = current[v];
+        for (int e = reverse.offsets[v]; e < reverse.offsets[v + 1]; ++e) {
+          T du = current[reverse.targets[e]];
+          if (du != inf and du + reverse.weights[e] < best) {
+            best = du + reverse.weights[e];
+          }
+        }
+        if constexpr (kStatsEnabled) {
+          scanned += reverse.offsets[v + 1] - reverse.offsets[v];
+        }
+        any = any or best != current[v];
+        next[v] = best;
+      }
+      if (any) {
+        changed = true;
+      }
+      sync.arrive_and_wait();
+    }
+    if constexpr (kStatsEnabled) {
+      relaxations += scanned;
+    }
+  });
+  if constexpr (kStatsEnabled) {
+    local.edgeRelaxations += relaxations;
+    local.bellmanFordPasses += round;
+  }
+  publishStats(options, local);
+  return current;
+}
+
+// k-hop distances from source into dist, pushing only from the vertices
+// whose distance changed in the previous round; scratch holds the second
+// buffer and the frontiers
+template <typename T>
+void boundedHopSearch(const CSRGraph<T>& G, int source, int k,
+                      std::pmr::vector<T>& dist,
+                      std::pmr::memory_resource* scratch,
+                      APSPStats* stats = nullptr) {
+  const int V = G.size();
+  const T inf = infinity<T>();
+  std::uint64_t relaxations {};
+  std::uint64_t improved {};
+  std::uint64_t rounds {};
+  dist.assign(V, inf);
+  dist[source] = T {};
+  std::pmr::vector<T> next(dist, scratch);
+  std::pmr::vector<int> frontier(scratch);
+  std::pmr::vector<int> nextFrontier(scratch);
+  std::pmr::vector<char> inNextFrontier(V, 0, scratch);
+  frontier.push_back(source);
+  for (int round = 0; round < k and !frontier.empty(); ++round) {
+    for (int u : frontier) {
+      T du = dist[u];
+      for (int e = G.offsets[u]; e < G.offsets[u + 1]; ++e) {
+        int v = G.targets[e];
+        T viaU = du + G.weights[e];
+        if constexpr (kStatsEnabled) {
+          ++relaxations;
+        }
+        if (viaU < next[v]) {
+          next[v] = viaU;
+          if constexpr (kStatsEnabled) {
+            ++improved;
+          }
+          if (!inNextFrontier[v]) {
+            inNextFrontier[v] = 1;
+            nextFrontier.push_back(v);
+          }
+        }
+      }
+    }
+    // only frontier entries differ between the buffers
+    for (int v : nextFrontier) {
+      dist[v] = next[v];
+      inNextFrontier[v] = 0;
+    }
+    std::swap(frontier, nextFrontier);
+    nextFrontier.clear();
+    if constexpr (kStatsEnabled) {
+      ++rounds;
+    }
+  }
+  if constexpr (kStatsEnabled) {
+    if (stats) {
+      stats->edgeRelaxations += relaxations;
+      stats->successfulRelaxations += improved;
+      stats->bellmanFordPasses += rounds;
+    }
+  }
+}
+
+// k-hop distances between every pair of vertices
+// sources are independent, so workers take whole sources
+template <typename T>
+std::vector<std::vector<T> >
+boundedHopAPSP(const Graph<T>& G, int k,
+               const APSPOptions& options = APSPOptions {}) {
+  const int V = G.size();
+  if (k < 0) {
+    throw std::invalid_argument("hop limit must be non-negative");
+  }
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  CSRGraph<T> csr {G, options.resource};
+  load.stop();
+  std::vector<std::vector<T> > result(V);
+  std::atomic<int> nextSource {0};
+  std::mutex statsMutex {};
+  std::size_t arenaBytes = V * (2 * sizeof(T) + 2 * sizeof(int) + 1) + 256;
+  runWorkers(workerCount(options.numThreads, V), [&](unsigned) {
+    ScratchArena arena {arenaBytes, options.resource};
+    APSPStats workerStats {};
+    for (int s = nextSource++; s < V; s = nextSource++) {
+      arena.reset();
+      std::pmr::vector<T> dist(&arena);
+      boundedHopSearch(csr, s, k, dist, &arena, &workerStats);
+      result[s].assign(dist.begin(), dist.end());
+    }
+    if constexpr (kStatsEnabled) {
+      std::lock_guard<std::mutex> lock {statsMutex};
+      local += workerStats;
+    }
+  });
+  publishStats(options, local);
+  return result;
+}
+
+#endif      // HOPLIMITED_HPP_
@@ -0,0 +1,224 @@
+#ifndef HUGEPAGES_HPP_
+#define HUGEPAGES_HPP_
+
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Huge-page backed memory for large matrices and CSR arrays
+// A dense matrix over 4 KB pages needs a TLB entry per 4 KB, so sweeping
+// rows and columns of a big one misses the TLB constantly; 2 MB pages
+// cut that by 512. HugePageResource serves every allocation of at least
+// its threshold from its own 2 MB aligned anonymous mapping advised with
+// MADV_HUGEPAGE, which lets transparent huge pages back it even in the
+// kernel's "madvise" mode. Smaller allocations, and large ones when the
+// mapping fails or off Linux, go to the upstream resource unchanged.
+// Pass one as APSPOptions::resource (or to a DistanceMatrix) to use it;
+// Floyd-Warshall and min-plus squaring keep their working matrix in it.
+// MADV_HUGEPAGE is only a request: hugePageBytes() reads back how much of
+// the live mappings the kernel really backs with huge pages.
+
+inline constexpr std::size_t kHugePageSize = std::size_t {2} << 20;
+
+// the kernel's transparent huge page policy: "always", "madvise" or
+// "never", or "unavailable" if it cannot be read
+inline std::string transparentHugePageMode() {
+  std::ifstream in {"/sys/kernel/mm/transparent_hugepage/enabled"};
+  std::string word {};
+  // the policy in force is the bracketed one, as in "always [madvise] never"
+  while (in >> word) {
+    if (word.size() > 2 and word.front() == '[' and word.back() == ']') {
+      return word.substr(1, word.size() - 2);
+    }
+  }
+  return "unavailable";
+}
+
+// what a HugePageResource did with the allocations it was asked for
+struct HugePageReport {
+  // allocations at or above the threshold
+  std::uint64_t largeAllocations {};
+  // of those, mapped 2 MB aligned and advised MADV_HUGEPAGE. This counts
+  // requests only; see HugePageResource::hugePageBytes for the backing
+  std::uint64_t advised {};
+  std::uint64_t advisedBytes {};
+  // large allocations that went to the upstream resource instead
+  std::uint64_t fallbacks {};
+};
+
+// thread-safe if upstream is
+class HugePageResource : public std::pmr::memory_resource {
+ private:
+  std::pmr::memory_resource* upstream {};
+  std::size_t threshold {};
+  mutable std::mutex mappedMutex {};
+  // start and length of each mapping still allocated
+  std::unordered_map<void*, std::size_t> mapped {};
+  std::atomic<std::uint64_t> largeAllocations {0};
+  std::atomic<std::uint64_t> advised {0};
+  std::atomic<std::uint64_t> advisedBytes {0};
+  std::atomic<std::uint64_t> fallbacks {0};
+
+  // a 2 MB aligned mapping of at least bytes advised MADV_HUGEPAGE, or
+  // nullptr; length receives its size
+  static void* mapHuge(std::size_t bytes, std::size_t& length) {
+#ifdef __linux__
+    length = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    // map a page more than needed and trim it to alignment
+    std::size_t padded = length + kHugePageSize;
+    void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+      return nullptr;
+    }
+    auto start = reinterpret_cast<std::uintptr_t>(raw);
+    std::uintptr_t aligned =
+        (start + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    if (aligned > start) {
+      munmap(raw, aligned - start);
+    }
+    std::size_t tail = start + padded - (aligned + length);
+    if (tail > 0) {
+      munmap(reinterpret_cast<void*>(aligned + length), tail);
+    }
+    void* p = reinterpret_cast<void*>(aligned);
+    if (madvise(p, length, MADV_HUGEPAGE) != 0) {
+      // kernel without transparent huge pages
+      munmap(p, length);
+      return nullptr;
+    }
+    return p;
+#else
+    (void)bytes;
+    (void)length;
+    return nullptr;
+#endif
+  }
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    if (bytes < threshold or alignment > kHugePageSize) {
+      return upstream->allocate(bytes, alignment);
+    }
+    ++largeAllocations;
+    std::size_t length {};
+    void* p = mapHuge(bytes, length);
+    if (!p) {
+      ++fallbacks;
+      return upstream->allocate(bytes, alignment);
+    }
+    {
+      std::lock_guard<std::mutex> lock {mappedMutex};
+      mapped.emplace(p, length);
+    }
+    ++advised;
+    advisedBytes += length;
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes,
+                     std::size_t alignment) override {
+    if (bytes >= threshold and alignment <= kHugePageSize) {
+      std::size_t length = 0;
+      {
+        std::lock_guard<std::mutex> lock {mappedMutex};
+        auto found = mapped.find(p);
+        if (found != mapped.end()) {
+          length = found->second;
+          mapped.erase(found);
+        }
+      }
+      if (length > 0) {
+#ifdef __linux__
+        munmap(p, length);
+#endif
+        return;
+      }
+    }
+    upstream->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept override {
+    return this == &other;
+  }
+
+ public:
+  // allocations of threshold bytes or more get huge pages
+  explicit HugePageResource(std::size_t threshold = kHugePageSize,
+                            std::pmr::memory_resource* upstream =
+                                std::pmr::get_default_resource())
+      : upstream {upstream}, threshold {threshold} {}
+
+  HugePageResource(const HugePageResource&) = delete;
+  HugePageResource& operator=(const HugePageResource&) = delete;
+
+  // mappings still allocated are released with the resource
+  ~HugePageResource() override {
+#ifdef __linux__
+    for (const auto& [p, length] : mapped) {
+      munmap(p, length);
+    }
+#endif
+  }
+
+  // bytes of the live mappings currently backed by huge pages, summed
+  // from AnonHugePages in /proc/self/smaps over the areas that overlap
+  // them; 0 off Linux or if smaps cannot be read. Reads the whole smaps
+  // file, so it is for reporting, not for hot paths
+  std::uint64_t hugePageBytes() const {
+    std::vector<std::pair<std::uintptr_t, std::uintptr_t> > ranges {};
+    {
+      std::lock_guard<std::mutex> lock {mappedMutex};
+      for (const auto& [p, length] : mapped) {
+        auto start = reinterpret_cast<std::uintptr_t>(p);
+        ranges.push_back({start, start + length});
+      }
+    }
+    std::uint64_t backed = 0;
+#ifdef __linux__
+    std::ifstream smaps {"/proc/self/smaps"};
+    std::string line {};
+    // overlap of the current area with our mappings, in bytes
+    std::uint64_t overlap = 0;
+    while (std::getline(smaps, line)) {
+      unsigned long long first {};
+      unsigned long long last {};
+      unsigned long long kilobytes {};
+      // an area starts with its address range, as in "7f00-7f40 rw-p ..."
+      if (std::sscanf(line.c_str(), "%llx-%llx ", &first, &last) == 2) {
+        overlap = 0;
+        for (const auto& [start, end] : ranges) {
+          std::uintptr_t low = std::max<std::uintptr_t>(start, first);
+          std::uintptr_t high = std::min<std::uintptr_t>(end, last);
+          overlap += high > low ? high - low : 0;
+        }
+      } else if (overlap > 0 and
+                 std::sscanf(line.c_str(), "AnonHugePages: %llu kB",
+                             &kilobytes) == 1) {
+        backed += std::min<std::uint64_t>(kilobytes * 1024, overlap);
+      }
+    }
+#endif
+    return backed;
+  }
+
+  HugePageReport report() const {
+    return {largeAllocations.load(), advised.load(), advisedBytes.load(),
+            fallbacks.load()};
+  }
+};
+
+#endif      // HUGEPAGES_HPP_
@@ -0,0 +1,359 @@
+#ifndef LANDMARK_HPP_
+#define LANDMARK_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+#include "checkpoint.hpp"
+#include "generate.hpp"
+
+// Landmark distance oracle
+// For graphs too large for APSP. A handful of landmarks L get a forward
+// and a backward shortest path tree each, after which any pair s, t has
+// triangle-inequality bounds in O(number of landmarks):
+//   d(s, t) >= d(L, t) - d(L, s),   d(s, t) >= d(s, L) - d(t, L),
+//   d(s, t) <= d(s, L) + d(L, t).
+// The lower bounds also drive ALT, an A* search that is exact and usually
+// settles a small part of the graph.
+// Negative weights are handled the way Johnson's algorithm does: the
+// index works on the graph reweighted by Bellman-Ford potentials, where
+// every weight is non-negative, and converts answers back.
+
+// lower is infinity<T>() if t is provably unreachable from s, upper is
+// infinity<T>() if no landmark lies on a path from s to t
+template <typename T>
+struct LandmarkBounds {
+  T lower {};
+  T upper {};
+};
+
+// numLandmarks distinct vertices of [0, N) drawn uniformly from seed
+inline std::vector<int> randomLandmarks(int N, int numLandmarks,
+                                        std::uint64_t seed) {
+  if (numLandmarks < 0) {
+    throw std::invalid_argument("number of landmarks must be non-negative");
+  }
+  std::vector<int> vertices(N);
+  std::iota(vertices.begin(), vertices.end(), 0);
+  numLandmarks = std::min(numLandmarks, N);
+  CounterRNG rng {seed, 0};
+  // partial Fisher-Yates shuffle
+  for (int i = 0; i < numLandmarks; ++i) {
+    std::swap(vertices[i], vertices[rng.between(i, N - 1)]);
+  }
+  vertices.resize(numLandmarks);
+  return vertices;
+}
+
+// per-thread workspace for exact queries; clearing it between queries is
+// O(1), so a query only costs what it visits
+template <typename T>
+class LandmarkSearch {
+ private:
+  std::vector<T> dist {};
+  std::vector<T> bound {};
+  std::vector<unsigned> stamp {};
+  std::vector<std::pair<T, int> > heap {};
+  unsigned generation {};
+  int settledCount {};
+
+  template <typename>
+  friend class LandmarkIndex;
+
+ public:
+  explicit LandmarkSearch(int N)
+      : dist(N), bound(N), stamp(N, 0) {}
+
+  // vertices settled by the last query
+  int settled() const {
+    return settledCount;
+  }
+};
+
+template <typename T>
+class LandmarkIndex {
+ private:
+  int numVertices {};
+  // identifies G in saved files
+  CheckpointHeader fileHeader {};
+  std::vector<int> landmarkList {};
+  // Johnson potentials; weights and distances below are reweighted
+  std::vector<T> potential {};
+  CSRGraph<T> reweighted {0};
+  // vertex-major, so the bounds for one vertex are contiguous:
+  // fromLandmark[v * k + l] is d(landmark l, v), toLandmark[v * k + l] is
+  // d(v, landmark l)
+  std::vector<T> fromLandmark {};
+  std::vector<T> toLandmark {};
+
+  LandmarkIndex() = default;
+
+  int k() const {
+    return static_cast<int>(landmarkList.size());
+  }
+
+  // reweights a CSR of G by the potentials; false on a negative cycle
+  bool prepare(const Graph<T>& G, const APSPOptions& options,
+               bool computePotentials) {
+    numVertices = G.size();
+    reweighted = CSRGraph<T> {G, options.resource};
+    fileHeader = checkpointHeader(3, reweighted);
+    std::pmr::vector<T> h(numVertices, T {}, options.resource);
+    if (computePotentials) {
+      if (!bellmanFordPotentials(reweighted, h)) {
+        return false;
+      }
+      potential.assign(h.begin(), h.end());
+    } else {
+      h.assign(potential.begin(), potential.end());
+    }
+    reweightEdges(reweighted, h);
+    return true;
+  }
+
+  // one forward and one backward search per landmark, in parallel
+  void buildTrees(const APSPOptions& options) {
+    const int V = numVertices;
+    const int K = k();
+    fromLandmark.assign(static_cast<std::size_t>(V) * K, T {});
+    toLandmark.assign(static_cast<std::size_t>(V) * K, T {});
+    CSRGraph<T> reverse = transpose(reweighted, options.resource);
+    std::atomic<int> nextTree {0};
+    std::size_t arenaBytes = V * (sizeof(T) + sizeof(std::pair<T, int>)) + 256;
+    runWorkers(workerCount(options.numThreads, 2 * K * kMinRowsPerWorker),
+               [&](unsigned) {
+      ScratchArena arena {arenaBytes, options.resource};
+      for (int tree = nextTree++; tree < 2 * K; tree = nextTree++) {
+        arena.reset();
+        std::pmr::vector<T> dist(&arena);
+        int l = tree / 2;
+        bool forward = tree % 2 == 0;
+        dijkstra(forward ? reweighted : reverse, landmarkList[l], dist,
+                 &arena);
+        std::vector<T>& out = forward ? fromLandmark : toLandmark;
+        for (int v = 0; v < V; ++v) {
+          out[static_cast<std::size_t>(v) * K + l] = dist[v];
+        }
+      }
+    });
+  }
+
+  // lower bound on the reweighted distance from s to t
+  T reweightedLower(int s, int t) const {
+    const T inf = infinity<T>();
+    const int K = k();
+    const T* fromS = fromLandmark.data() + static_cast<std::size_t>(s) * K;
+    const T* fromT = fromLandmark.data() + static_cast<std::size_t>(t) * K;
+    const T* toS = toLandmark.data() + static_cast<std::size_t>(s) * K;
+    const T* toT = toLandmark.data() + static_cast<std::size_t>(t) * K;
+    T best {};
+    for (int l = 0; l < K; ++l) {
+      if (fromS[l] != inf) {
+        if (fromT[l] == inf) {
+          // L reaches s but not t, so s cannot reach t
+          return inf;
+        }
+        best = std::max(best, fromT[l] - fromS[l]);
+      }
+      if (toT[l] != inf) {
+        if (toS[l] == inf) {
+          // t reaches L but s does not, so s cannot reach t
+          return inf;
+        }
+        best = std::max(best, toS[l] - toT[l]);
+      }
+    }
+    return best;
+  }
+
+  T reweightedUpper(int s, int t) const {
+    const T inf = infinity<T>();
+    const int K = k();
+    const T* toS = toLandmark.data() + static_cast<std::size_t>(s) * K;
+    const T* fromT = fromLandmark.data() + static_cast<std::size_t>(t) * K;
+    T best = inf;
+    for (int l = 0; l < K; ++l) {
+      if (toS[l] != inf and fromT[l] != inf) {
+        best = std::min(best, toS[l] + fromT[l]);
+      }
+    }
+    return best;
+  }
+
+  // reweighted distance d'(s, t) back to the original weights
+  T original(T d, int s, int t) const {
+    return d == infinity<T>() ? d : d - potential[s] + potential[t];
+  }
+
+  void checkVertex(int v) const {
+    if (v < 0 or v >= numVertices) {
+      throw std::out_of_range("invalid vertex number");
+    }
+  }
+
+ public:
+  // index with numLandmarks landmarks picked uniformly at random from
+  // seed; throws std::invalid_argument if G has a negative weight cycle
+  LandmarkIndex(const Graph<T>& G, int numLandmarks, std::uint64_t seed = 0,
+                const APSPOptions& options = APSPOptions {})
+      : LandmarkIndex(G, randomLandmarks(G.size(), numLandmarks, seed),
+                      options) {}
+
+  // index over the given landmark vertices
+  LandmarkIndex(const Graph<T>& G, std::vector<int> landmarks,
+                const APSPOptions& options)
+      : landmarkList {std::move(landmarks)} {
+    for (int l : landmarkList) {
+      if (l < 0 or l >= G.size()) {
+        throw std::out_of_range("invalid vertex number");
+      }
+    }
+    if (!prepare(G, options, true)) {
+      throw std::invalid_argument("graph has a negative weight cycle");
+    }
+    buildTrees(options);
+  }
+
+  int size() const {
+    return numVertices;
+  }
+
+  const std::vector<int>& landmarks() const {
+    return landmarkList;
+  }
+
+  // triangle-inequality bounds on d(s, t) in O(number of landmarks)
+  LandmarkBounds<T> bounds(int s, int t) const {
+    checkVertex(s);
+    checkVertex(t);
+    if (s == t) {
+      return {T {}, T {}};
+    }
+    return {original(reweightedLower(s, t), s, t),
+            original(reweightedUpper(s, t), s, t)};
+  }
+
+  // exact d(s, t) by A* with the landmark lower bounds as its heuristic
+  T distance(int s, int t, LandmarkSearch<T>& search) const {
+    checkVertex(s);
+    checkVertex(t);
+    const T inf = infinity<T>();
+    search.settledCount = 0;
+    if (s == t) {
+      return T {};
+    }
+    if (reweightedLower(s, t) == inf) {
+      return inf;
+    }
+    if (++search.generation == 0) {
+      std::fill(search.stamp.begin(), search.stamp.end(), 0);
+      search.generation = 1;
+    }
+    auto touch = [&](int v) {
+      if (search.stamp[v] != search.generation) {
+        search.stamp[v] = search.generation;
+        search.dist[v] = inf;
+        search.bound[v] = reweightedLower(v, t);
+      }
+    };
+    using Entry = std::pair<T, int>;
+    auto& heap = search.heap;
+    heap.clear();
+    touch(s);
+    search.dist[s] = T {};
+    heap.push_back({search.bound[s], s});
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+      auto [key, u] = heap.back();
+      heap.pop_back();
+      if (search.dist[u] + search.bound[u] < key) {
+        continue;
+      }
+      if (u == t) {
+        return original(search.dist[u], s, t);
+      }
+      ++search.settledCount;
+      for (int e = reweighted.offsets[u]; e < reweighted.offsets[u + 1];
+           ++e) {
+        int v = reweighted.targets[e];
+        touch(v);
+        if (search.bound[v] == inf) {
+          continue;
+        }
+        T viaU = search.dist[u] + reweighted.weights[e];
+        if (viaU < search.dist[v]) {
+          search.dist[v] = viaU;
+          heap.push_back({viaU + search.bound[v], v});
+          std::push_heap(heap.begin(), heap.end(), std::greater<Entry> {});
+        }
+      }
+    }
+    return inf;
+  }
+
+  // exact d(s, t) with a workspace of its own, which costs O(V)
+  T distance(int s, int t) const {
+    LandmarkSearch<T> search {numVertices};
+    return distance(s, t, search);
+  }
+
+  // writes the landmark trees and potentials to path; the graph itself
+  // is not stored and must be passed to load
+  void save(const std::string& path) const {
+    std::ofstream out {path, std::ios::binary | std::ios::trunc};
+    std::int64_t K = k();
+    writeBytes(out, &fileHeader, sizeof fileHeader);
+    writeBytes(out, &K, sizeof K);
+    writeBytes(out, landmarkList.data(), landmarkList.size() * sizeof(int));
+    writeBytes(out, potential.data(), potential.size() * sizeof(T));
+    writeBytes(out, fromLandmark.data(), fromLandmark.size() * sizeof(T));
+    writeBytes(out, toLandmark.data(), toLandmark.size() * sizeof(T));
+    out.flush();
+    if (!out) {
+      throw std::runtime_error("could not write landmark index " + path);
+    }
+  }
+
+  // reads an index saved for G; throws std::invalid_argument if the file
+  // was saved for another graph or is damaged
+  static LandmarkIndex load(const std::string& path, const Graph<T>& G,
+                            const APSPOptions& options = APSPOptions {}) {
+    CSRGraph<T> csr {G, options.resource};
+    std::ifstream in = openCheckpoint(path, checkpointHeader(3, csr));
+    if (!in.is_open()) {
+      throw std::invalid_argument("no landmark index at " + path);
+    }
+    LandmarkIndex index {};
+    const int V = G.size();
+    std::int64_t K {};
+    bool whole = readBytes(in, &K, sizeof K) and K >= 0 and K <= V;
+    if (whole) {
+      index.landmarkList.resize(K);
+      index.potential.resize(V);
+      index.fromLandmark.resize(static_cast<std::size_t>(V) * K);
+      index.toLandmark.resize(static_cast<std::size_t>(V) * K);
+      whole = readBytes(in, index.landmarkList.data(), K * sizeof(int)) and
+              readBytes(in, index.potential.data(), V * sizeof(T)) and
+              readBytes(in, index.fromLandmark.data(),
+                        index.fromLandmark.size() * sizeof(T)) and
+              readBytes(in, index.toLandmark.data(),
+                        index.toLandmark.size() * sizeof(T));
+    }
+    if (!whole) {
+      throw std::invalid_argument("landmark index " + path + " is truncated");
+    }
+    index.prepare(G, options, false);
+    return index;
+  }
+
+};
+
+#endif      // LANDMARK_HPP_
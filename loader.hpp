@@ -0,0 +1,476 @@
+#ifndef LOADER_HPP_
+#define LOADER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "graph.hpp"
+#ifdef GRAPH_ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef GRAPH_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+// Parallel loader for edge list files
+// Reads the same format as Graph(const std::string&): the vertex count,
+// then one "from to weight" edge per line. The text is read, decompressed
+// if need be, a block of LoadOptions::blockBytes at a time; each block is
+// cut into one chunk per worker at newline boundaries, and each worker
+// parses its chunk into its own edge buffer. The buffers are merged into
+// a CSRGraph by a counting sort on the source whose offsets come from a
+// parallel prefix sum. As with Graph::addEdge, the first of several edges
+// between the same pair of vertices wins.
+// Peak memory is one block of text, the parsed edges (about 12 bytes
+// each for int weights) and, while they are sorted into rows, a slot of
+// about 24 bytes per edge, besides the CSR itself.
+// gzip input is decompressed if built with GRAPH_ENABLE_ZLIB (link -lz)
+// and zstd input if built with GRAPH_ENABLE_ZSTD (link -lzstd); the
+// format is recognised by its magic bytes, so plain text needs neither.
+// Weights are parsed straight into T: a floating point T takes any
+// std::from_chars number, while an integer T takes decimals that are
+// exact after scaling by 10^LoadOptions::fixedPointDigits, so "0.26"
+// loads as 26 with two digits and is rejected rather than truncated to 0
+// with none.
+
+struct LoadOptions {
+  // the CSR arrays are allocated from here
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+  // worker threads; 0 means std::thread::hardware_concurrency()
+  unsigned numThreads = 0;
+  // integer weights are the file's weights times 10^fixedPointDigits,
+  // which must not be negative; must be 0 for floating point weights
+  int fixedPointDigits = 0;
+  // text parsed per block; a line longer than this grows the block
+  std::size_t blockBytes = std::size_t {64} << 20;
+};
+
+// reads the decimal number at [p, stop), such as "-12.5", as the integer
+// number * 10^digits; returns the end of the number, or nullptr if there
+// is no number, it has nonzero digits beyond the digits kept or the
+// scaled value does not fit in T
+template <typename T>
+const char* parseFixedPoint(const char* p, const char* stop, int digits,
+                            T& value) {
+  static_assert(std::is_integral_v<T>);
+  using Magnitude = unsigned long long;
+  const bool negative = p < stop and *p == '-';
+  p += negative ? 1 : 0;
+  // the largest magnitude T holds with this sign
+  Magnitude limit = static_cast<Magnitude>(std::numeric_limits<T>::max());
+  if (negative) {
+    limit = std::is_signed_v<T> ? limit + 1 : 0;
+  }
+  Magnitude magnitude = 0;
+  auto push = [&magnitude, limit](int digit) {
+    if (Magnitude(digit) > limit or magnitude > (limit - digit) / 10) {
+      return false;
+    }
+    magnitude = magnitude * 10 + digit;
+    return true;
+  };
+  auto isDigit = [](char c) {
+    return c >= '0' and c <= '9';
+  };
+  bool any = false;
+  for (; p < stop and isDigit(*p); ++p) {
+    any = true;
+    if (!push(*p - '0')) {
+      return nullptr;
+    }
+  }
+  int kept = 0;
+  if (p < stop and *p == '.') {
+    for (++p; p < stop and isDigit(*p); ++p) {
+      any = true;
+      if (kept < digits) {
+        ++kept;
+        if (!push(*p - '0')) {
+          return nullptr;
+        }
+      } else if (*p != '0') {
+        return nullptr;
+      }
+    }
+  }
+  if (!any) {
+    return nullptr;
+  }
+  for (; kept < digits; ++kept) {
+    if (!push(0)) {
+      return nullptr;
+    }
+  }
+  // -magnitude computed unsigned wraps to the right two's complement bits
+  value = static_cast<T>(negative ? Magnitude {0} - magnitude : magnitude);
+  return p;
+}
+
+// Decompressed text of an edge list file, read a piece at a time
+// Only the first four bytes are read to recognise the format; the rest
+// is read and decompressed as the caller asks for it. The zstd branch is
+// compiled only with GRAPH_ENABLE_ZSTD, so a build without it does not
+// check that code at all.
+class EdgeListReader {
+ private:
+  enum class Format { plain, gzip, zstd };
+
+  std::string path {};
+  Format format {Format::plain};
+  std::ifstream file {};
+#ifdef GRAPH_ENABLE_ZLIB
+  gzFile gz {};
+#endif
+#ifdef GRAPH_ENABLE_ZSTD
+  ZSTD_DStream* stream {};
+  std::vector<char> compressed {};
+  ZSTD_inBuffer input {};
+  bool inputEnded = false;
+  // what the last ZSTD_decompressStream returned: 0 once a frame is
+  // complete, so anything else at the end of the file means truncation
+  std::size_t lastStatus = 1;
+#endif
+
+ public:
+  explicit EdgeListReader(const std::string& path) : path {path} {
+    file.open(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("could not open " + path);
+    }
+    unsigned char magic[4] {};
+    file.read(reinterpret_cast<char*>(magic), sizeof magic);
+    std::streamsize got = file.gcount();
+    if (got >= 2 and magic[0] == 0x1F and magic[1] == 0x8B) {
+      format = Format::gzip;
+    } else if (got == 4 and magic[0] == 0x28 and magic[1] == 0xB5 and
+               magic[2] == 0x2F and magic[3] == 0xFD) {
+      format = Format::zstd;
+    }
+    file.clear();
+    file.seekg(0);
+    if (format == Format::gzip) {
+#ifdef GRAPH_ENABLE_ZLIB
+      file.close();
+      // gzread also handles concatenated members
+      gz = gzopen(path.c_str(), "rb");
+      if (!gz) {
+        throw std::runtime_error("could not open " + path);
+      }
+      gzbuffer(gz, 1 << 20);
+#else
+      throw std::runtime_error(path + " is gzip; build with GRAPH_ENABLE_ZLIB");
+#endif
+    } else if (format == Format::zstd) {
+#ifdef GRAPH_ENABLE_ZSTD
+      stream = ZSTD_createDStream();
+      ZSTD_initDStream(stream);
+      compressed.resize(ZSTD_DStreamInSize());
+      input = {compressed.data(), 0, 0};
+#else
+      throw std::runtime_error(path + " is zstd; build with GRAPH_ENABLE_ZSTD");
+#endif
+    }
+  }
+
+  EdgeListReader(const EdgeListReader&) = delete;
+  EdgeListReader& operator=(const EdgeListReader&) = delete;
+
+  ~EdgeListReader() {
+#ifdef GRAPH_ENABLE_ZLIB
+    if (gz) {
+      gzclose(gz);
+    }
+#endif
+#ifdef GRAPH_ENABLE_ZSTD
+    if (stream) {
+      ZSTD_freeDStream(stream);
+    }
+#endif
+  }
+
+  // reads up to size bytes of text into out; returns how many, 0 only at
+  // the end. Throws std::runtime_error for unreadable, corrupt or
+  // truncated input
+  std::size_t read(char* out, std::size_t size) {
+    if (format == Format::plain) {
+      file.read(out, static_cast<std::streamsize>(size));
+      if (file.bad()) {
+        throw std::runtime_error("could not read " + path);
+      }
+      return static_cast<std::size_t>(file.gcount());
+    }
+#ifdef GRAPH_ENABLE_ZLIB
+    if (format == Format::gzip) {
+      unsigned request = static_cast<unsigned>(
+          std::min<std::size_t>(size, std::size_t {1} << 30));
+      int got = gzread(gz, out, request);
+      int error = Z_OK;
+      // a truncated member ends with 0 bytes read and Z_BUF_ERROR set
+      if (got <= 0) {
+        gzerror(gz, &error);
+      }
+      if (got < 0 or (error != Z_OK and error != Z_STREAM_END)) {
+        throw std::runtime_error("corrupt or truncated gzip input " + path);
+      }
+      return static_cast<std::size_t>(got);
+    }
+#endif
+#ifdef GRAPH_ENABLE_ZSTD
+    ZSTD_outBuffer output {out, size, 0};
+    while (output.pos < output.size) {
+      if (input.pos == input.size and !inputEnded) {
+        file.read(compressed.data(),
+                  static_cast<std::streamsize>(compressed.size()));
+        if (file.bad()) {
+          throw std::runtime_error("could not read " + path);
+        }
+        input = {compressed.data(), static_cast<std::size_t>(file.gcount()),
+                 0};
+        inputEnded = input.size == 0;
+      }
+      if (inputEnded and lastStatus == 0) {
+        break;
+      }
+      // at the end of the input this only flushes what the decoder holds
+      std::size_t before = output.pos;
+      lastStatus = ZSTD_decompressStream(stream, &output, &input);
+      if (ZSTD_isError(lastStatus)) {
+        throw std::runtime_error("corrupt zstd input " + path);
+      }
+      if (inputEnded and lastStatus != 0 and output.pos == before) {
+        throw std::runtime_error("truncated zstd input " + path);
+      }
+    }
+    return output.pos;
+#else
+    return 0;
+#endif
+  }
+};
+
+// CSR of the edge list in path, sorted by target within each row
+template <typename T>
+CSRGraph<T> loadEdgeList(const std::string& path,
+                         const LoadOptions& options = LoadOptions {}) {
+  if (options.blockBytes == 0) {
+    throw std::invalid_argument("blockBytes must be positive");
+  }
+  auto isSpace = [](char c) {
+    return c == ' ' or c == '\t' or c == '\n' or c == '\r';
+  };
+  auto malformed = [&path]() {
+    return std::invalid_argument("malformed edge list " + path);
+  };
+  const int digits = options.fixedPointDigits;
+  if (digits < 0 or (digits > 0 and !std::is_integral_v<T>)) {
+    throw std::invalid_argument(
+        "fixedPointDigits needs integer weights and must not be negative");
+  }
+  // reads one number at p, skipping whitespace before it; the number must
+  // be followed by whitespace or stop. Integer weights are fixed point
+  auto parse = [&](const char*& p, const char* stop, auto& value,
+                   bool isWeight = false) {
+    while (p < stop and isSpace(*p)) {
+      ++p;
+    }
+    using Value = std::remove_cvref_t<decltype(value)>;
+    const char* next = nullptr;
+    if constexpr (std::is_integral_v<Value>) {
+      if (isWeight) {
+        next = parseFixedPoint(p, stop, digits, value);
+      }
+    }
+    if (!isWeight or !std::is_integral_v<Value>) {
+      auto [end, error] = std::from_chars(p, stop, value);
+      next = error == std::errc {} ? end : nullptr;
+    }
+    if (!next or (next < stop and !isSpace(*next))) {
+      throw malformed();
+    }
+    p = next;
+  };
+
+  struct Edge {
+    int from;
+    int to;
+    T weight;
+  };
+  // edge buffers in file order, one per block and worker
+  std::vector<std::vector<Edge> > pieces {};
+  CSRGraph<T> csr {0, options.resource};
+  int V = -1;
+
+  // parses the whole lines in [body, end) into new pieces, counting the
+  // out-degrees in csr.offsets
+  auto parseBlock = [&](const char* body, const char* end) {
+    // chunk boundaries, each just after a newline
+    unsigned workers = workerCount(
+        options.numThreads, static_cast<int>((end - body) / (1 << 16)));
+    std::vector<const char*> cut(workers + 1, end);
+    cut[0] = body;
+    for (unsigned c = 1; c < workers; ++c) {
+      const char* p = body + (end - body) * c / workers;
+      p = std::max(p, cut[c - 1]);
+      while (p < end and *p != '\n') {
+        ++p;
+      }
+      cut[c] = p;
+    }
+    std::size_t firstPiece = pieces.size();
+    pieces.resize(firstPiece + workers);
+    runWorkers(workers, [&](unsigned c) {
+      std::vector<Edge>& edges = pieces[firstPiece + c];
+      const char* p = cut[c];
+      const char* stop = cut[c + 1];
+      while (true) {
+        while (p < stop and isSpace(*p)) {
+          ++p;
+        }
+        if (p == stop) {
+          break;
+        }
+        Edge edge {};
+        parse(p, stop, edge.from);
+        parse(p, stop, edge.to);
+        parse(p, stop, edge.weight, true);
+        if (edge.from < 0 or edge.from >= V or edge.to < 0 or
+            edge.to >= V) {
+          throw std::out_of_range("invalid vertex number");
+        }
+        edges.push_back(edge);
+      }
+      for (const Edge& edge : edges) {
+        std::atomic_ref<int> {csr.offsets[edge.from]}.fetch_add(
+            1, std::memory_order_relaxed);
+      }
+    });
+  };
+
+  // buffer[0, filled) is text not parsed yet, beginning at a line start
+  EdgeListReader reader {path};
+  std::string buffer(options.blockBytes, '\0');
+  std::size_t filled = 0;
+  bool atEnd = false;
+  while (true) {
+    while (filled < buffer.size() and !atEnd) {
+      std::size_t got = reader.read(buffer.data() + filled,
+                                    buffer.size() - filled);
+      atEnd = got == 0;
+      filled += got;
+    }
+    const char* begin = buffer.data();
+    const char* end = begin + filled;
+    // the last line may continue in the next block
+    if (!atEnd) {
+      const char* lastNewline = end;
+      while (lastNewline > begin and lastNewline[-1] != '\n') {
+        --lastNewline;
+      }
+      if (lastNewline == begin) {
+        buffer.resize(buffer.size() * 2);
+        continue;
+      }
+      end = lastNewline;
+    }
+    const char* body = begin;
+    if (V < 0) {
+      parse(body, end, V);
+      if (V < 0) {
+        throw malformed();
+      }
+      csr.offsets.assign(V + 1, 0);
+    }
+    parseBlock(body, end);
+    filled = static_cast<std::size_t>(begin + filled - end);
+    std::copy(end, end + filled, buffer.data());
+    if (atEnd) {
+      break;
+    }
+  }
+  buffer = std::string {};
+  parallelPrefixSum(csr.offsets, V, options.numThreads);
+
+  // scatter, remembering each edge's position in the file so duplicates
+  // can keep the first
+  const std::size_t E = static_cast<std::size_t>(csr.offsets[V]);
+  std::vector<long long> pieceStart(pieces.size() + 1, 0);
+  for (std::size_t c = 0; c < pieces.size(); ++c) {
+    pieceStart[c + 1] = pieceStart[c] + pieces[c].size();
+  }
+  std::vector<std::tuple<int, long long, T> > slots(E);
+  std::vector<int> fill(csr.offsets.begin(), csr.offsets.end() - 1);
+  unsigned workers = workerCount(
+      options.numThreads,
+      static_cast<int>(std::min<std::size_t>(E >> 10, 1 << 30)));
+  std::atomic<std::size_t> nextPiece {0};
+  runWorkers(workers, [&](unsigned) {
+    for (std::size_t c = nextPiece++; c < pieces.size(); c = nextPiece++) {
+      const std::vector<Edge>& edges = pieces[c];
+      for (std::size_t k = 0; k < edges.size(); ++k) {
+        int slot = std::atomic_ref<int> {fill[edges[k].from]}.fetch_add(
+            1, std::memory_order_relaxed);
+        slots[slot] = {edges[k].to,
+                       pieceStart[c] + static_cast<long long>(k),
+                       edges[k].weight};
+      }
+      // each buffer goes as soon as it is scattered
+      std::vector<Edge> {}.swap(pieces[c]);
+    }
+  });
+  pieces.clear();
+
+  // sort each row by target then file position and keep the first of
+  // each target at the front of the row
+  std::pmr::vector<int> degree(V + 1, 0, options.resource);
+  unsigned rowWorkers = workerCount(options.numThreads, V);
+  std::atomic<int> nextRow {0};
+  constexpr int rowChunk = 1024;
+  runWorkers(rowWorkers, [&](unsigned) {
+    for (int first = nextRow.fetch_add(rowChunk); first < V;
+         first = nextRow.fetch_add(rowChunk)) {
+      for (int u = first; u < std::min(V, first + rowChunk); ++u) {
+        auto rowBegin = slots.begin() + csr.offsets[u];
+        auto rowEnd = slots.begin() + csr.offsets[u + 1];
+        std::sort(rowBegin, rowEnd);
+        auto kept = std::unique(rowBegin, rowEnd, [](const auto& a,
+                                                     const auto& b) {
+          return std::get<0>(a) == std::get<0>(b);
+        });
+        degree[u] = static_cast<int>(kept - rowBegin);
+      }
+    }
+  });
+  parallelPrefixSum(degree, V, options.numThreads);
+  csr.targets.resize(degree[V]);
+  csr.weights.resize(degree[V]);
+  runWorkers(rowWorkers, [&](unsigned id) {
+    auto [first, last] = workerRows(V, id, rowWorkers);
+    for (int u = first; u < last; ++u) {
+      for (int k = 0; k < degree[u + 1] - degree[u]; ++k) {
+        const auto& [to, position, weight] = slots[csr.offsets[u] + k];
+        csr.targets[degree[u] + k] = to;
+        csr.weights[degree[u] + k] = weight;
+      }
+    }
+  });
+  csr.offsets.assign(degree.begin(), degree.end());
+  return csr;
+}
+
+// Graph of the edge list in path
+template <typename T>
+Graph<T> loadGraph(const std::string& path,
+                   const LoadOptions& options = LoadOptions {}) {
+  return toGraph(loadEdgeList<T>(path, options), options.resource);
+}
+
+#endif      // LOADER_HPP_
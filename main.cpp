@@ -3,7 +3,27 @@
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <memory_resource>
+#include <atomic>
+#include <sstream>
 #include "graph.hpp"
+#include "minplus.hpp"
+#include "hoplimited.hpp"
+#include "verify.hpp"
+#include "generate.hpp"
+#include "reachability.hpp"
+#include "versioned.hpp"
+#include "async.hpp"
+#include "checkpoint.hpp"
+#include "compressed.hpp"
+#include "landmark.hpp"
+#include "contraction.hpp"
+#include "bidirectional.hpp"
+#include "hugepages.hpp"
+#include "batch.hpp"
+#include "fixed.hpp"
+#include "loader.hpp"
+#include "cache.hpp"
 
 // *** Negative Cycle Test Cases
 
@@ -369,19 +389,7 @@ using apspFunction =
 
 // function to create a random graph and test the output of f on it
 void randomTest(apspFunction f, int N, unsigned seed, double p = 0.5) {
-  std::mt19937 mt {seed};
-  std::uniform_int_distribution<int> vertexDist {0, N - 1};
-  std::binomial_distribution<int> heads {1, p};
-  std::uniform_int_distribution<int> weight {-1, 100};
-  Graph<int> G {N};
-  for (int i = 0; i < N; ++i) {
-    for (int j = 0; j < N; ++j) {
-      if (heads(mt)) {
-        int edgeWeight = weight(mt);
-        G.addEdge(i, j, edgeWeight);
-      }
-    }
-  }
+  Graph<int> G = createRandomGraph(N, seed, p);
   ASSERT_FALSE(existsNegativeCycle(G));
   std::vector<std::vector<int> > distanceMatrix = f(G);
   for (int v = 0; v < G.size(); ++v) {
@@ -1583,6 +1591,1903 @@ TEST(FWTest, random500) {
 //   randomTest(floydWarshallAPSP<int>, 1'000, 2'389'239, 0.005);
 // }
 
+// *** Memory resource tests
+
+// thread-safe memory resource that counts the bytes handed out through it
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  std::atomic<std::size_t> allocations {};
+  std::atomic<std::size_t> bytes {};
+
+ private:
+  void* do_allocate(std::size_t n, std::size_t alignment) override {
+    ++allocations;
+    bytes += n;
+    return std::pmr::new_delete_resource()->allocate(n, alignment);
+  }
+  void do_deallocate(void* p, std::size_t n, std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, n, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST(memoryResourceTest, graphAllocatesFromResource) {
+  CountingResource counter {};
+  Graph<int> G {4, &counter};
+  std::size_t before = counter.allocations;
+  G.addEdge(0, 1, 3);
+  G.addEdge(1, 2, 4);
+  EXPECT_EQ(G.resource(), &counter);
+  EXPECT_GT(counter.allocations, before);
+  EXPECT_EQ(G.getEdgeWeight(1, 2), 4);
+  EXPECT_EQ(G.numEdges(), 2u);
+}
+
+TEST(memoryResourceTest, inNeighboursAllocateFromResource) {
+  CountingResource counter {};
+  Graph<int> G {3, &counter};
+  G.addEdge(0, 2, 3);
+  G.addEdge(1, 2, 4);
+  std::size_t before = counter.bytes;
+  EXPECT_EQ(G.inNeighbours(2).size(), 2u);
+  // offsets for 4 entries and two (source, weight) pairs
+  EXPECT_GE(counter.bytes - before,
+            4 * sizeof(int) + 2 * sizeof(Graph<int>::InEdge));
+}
+
+TEST(memoryResourceTest, negativeCycleCheckTakesResource) {
+  CountingResource counter {};
+  Graph<int> G {3};
+  G.addEdge(0, 1, 2);
+  G.addEdge(1, 2, -1);
+  EXPECT_FALSE(existsNegativeCycle(G, &counter));
+  EXPECT_GT(counter.allocations, 0u);
+  G.addEdge(2, 0, -2);
+  EXPECT_TRUE(existsNegativeCycle(G, &counter));
+}
+
+TEST(memoryResourceTest, fileGraphAllocatesFromResource) {
+  std::pmr::unsynchronized_pool_resource pool {};
+  Graph<int> G {"tinyEWD.txt", &pool};
+  EXPECT_EQ(G.resource(), &pool);
+  EXPECT_EQ(G.size(), 8);
+  EXPECT_EQ(G.numEdges(), 15u);
+}
+
+TEST(memoryResourceTest, scratchArenaReusesBlock) {
+  CountingResource counter {};
+  ScratchArena arena {1024, &counter};
+  std::size_t afterConstruction = counter.allocations;
+  for (int round = 0; round < 10; ++round) {
+    arena.reset();
+    std::pmr::vector<int> v(&arena);
+    v.resize(100);
+  }
+  EXPECT_EQ(counter.allocations, afterConstruction);
+}
+
+TEST(memoryResourceTest, scratchArenaGrowsAfterOverflow) {
+  CountingResource counter {};
+  ScratchArena arena {64, &counter};
+  {
+    std::pmr::vector<int> v(&arena);
+    v.resize(1000);
+    v[999] = 7;
+    EXPECT_EQ(v[999], 7);
+  }
+  arena.reset();
+  EXPECT_GE(arena.blockSize(), 1000 * sizeof(int));
+  std::size_t afterGrowth = counter.allocations;
+  {
+    std::pmr::vector<int> v(&arena);
+    v.resize(1000);
+  }
+  arena.reset();
+  EXPECT_EQ(counter.allocations, afterGrowth);
+}
+
+TEST(memoryResourceTest, johnsonWithResourceMatchesDefault) {
+  Graph<int> G = createRandomGraph(150, 8'271'003, 0.05);
+  ASSERT_FALSE(existsNegativeCycle(G));
+  CountingResource counter {};
+  APSPOptions options {};
+  options.resource = &counter;
+  options.numThreads = 4;
+  std::vector<std::vector<int> > expected = johnsonAPSP(G);
+  std::vector<std::vector<int> > result = johnsonAPSPWithOptions(G, options);
+  EXPECT_EQ(result, expected);
+  EXPECT_GT(counter.bytes, 0u);
+  // one arena per worker rather than one allocation per source
+  EXPECT_LT(counter.allocations, 50u);
+}
+
+TEST(memoryResourceTest, floydWarshallThreadsMatchJohnson) {
+  Graph<int> G = createRandomGraph(130, 1'902'334, 0.05);
+  ASSERT_FALSE(existsNegativeCycle(G));
+  APSPOptions options {};
+  options.numThreads = 3;
+  EXPECT_EQ(floydWarshallAPSPWithOptions(G, options), johnsonAPSP(G));
+}
+
+TEST(memoryResourceTest, negativeCycleGivesEmptyMatrix) {
+  Graph<int> G {3};
+  G.addEdge(0, 1, 1);
+  G.addEdge(1, 2, -3);
+  G.addEdge(2, 1, 1);
+  EXPECT_TRUE(johnsonAPSP(G).empty());
+  EXPECT_TRUE(floydWarshallAPSP(G).empty());
+}
+
+TEST(memoryResourceTest, parallelFloydWarshallStopsOnNegativeDiagonal) {
+  // a negative self loop on a vertex with no other out-edges is first
+  // seen in iteration 70, while the other workers read row 70
+  Graph<int> G = createRandomGraph(90, 5'123, 0.1);
+  for (int j = 0; j < G.size(); ++j) {
+    G.removeEdge(70, j);
+  }
+  G.addEdge(70, 70, -1);
+  APSPOptions options {};
+  options.numThreads = 4;
+  EXPECT_TRUE(floydWarshallAPSPWithOptions(G, options).empty());
+  // a negative cycle through the middle rows
+  Graph<int> H = createRandomGraph(90, 5'124, 0.1);
+  H.removeEdge(45, 46);
+  H.removeEdge(46, 45);
+  H.addEdge(45, 46, -500);
+  H.addEdge(46, 45, -500);
+  EXPECT_TRUE(floydWarshallAPSPWithOptions(H, options).empty());
+}
+
+// *** Instrumentation tests
+
+TEST(statsTest, johnsonCountsWork) {
+  Graph<int> G {"tinyEWD.txt"};
+  APSPStats stats {};
+  APSPOptions options {};
+  options.stats = &stats;
+  std::vector<std::vector<int> > result = johnsonAPSPWithOptions(G, options);
+  ASSERT_EQ(result.at(0).at(1), 105);
+  if constexpr (kStatsEnabled) {
+    // every vertex is reachable from every other, so each of the 8
+    // Dijkstra runs scans all 15 edges once
+    EXPECT_GE(stats.edgeRelaxations, 8u * 15u);
+    EXPECT_GT(stats.bellmanFordPasses, 0u);
+    // the heap is drained, so every push is matched by a pop
+    EXPECT_EQ(stats.heapPops, stats.heapPushes);
+    EXPECT_LE(stats.successfulRelaxations, stats.edgeRelaxations);
+  } else {
+    EXPECT_EQ(stats.edgeRelaxations, 0u);
+    EXPECT_EQ(stats.heapPushes, 0u);
+    EXPECT_EQ(stats.dijkstraTime.count(), 0);
+  }
+}
+
+TEST(statsTest, negativeCycleCountsPasses) {
+  Graph<int> G {2};
+  G.addEdge(0, 1, 1);
+  G.addEdge(1, 0, -3);
+  APSPStats stats {};
+  APSPOptions options {};
+  options.stats = &stats;
+  ASSERT_TRUE(existsNegativeCycle(G, options));
+  if constexpr (kStatsEnabled) {
+    EXPECT_EQ(stats.bellmanFordPasses, 2u);
+    EXPECT_EQ(stats.edgeRelaxations, 4u);
+  } else {
+    EXPECT_EQ(stats.bellmanFordPasses, 0u);
+  }
+}
+
+TEST(statsTest, workerCountersAreMerged) {
+  Graph<int> G = createRandomGraph(200, 77'123, 0.05);
+  APSPStats serial {};
+  APSPStats parallel {};
+  APSPOptions options {};
+  options.numThreads = 1;
+  options.stats = &serial;
+  std::vector<std::vector<int> > expected =
+      floydWarshallAPSPWithOptions(G, options);
+  options.numThreads = 4;
+  options.stats = &parallel;
+  EXPECT_EQ(floydWarshallAPSPWithOptions(G, options), expected);
+  EXPECT_EQ(serial.edgeRelaxations, parallel.edgeRelaxations);
+  EXPECT_EQ(serial.successfulRelaxations, parallel.successfulRelaxations);
+}
+
+TEST(statsTest, exportsEveryCounter) {
+  APSPStats stats {};
+  stats.heapPushes = 3;
+  std::vector<std::string> names {};
+  stats.forEach([&names](const char* name, std::uint64_t) {
+    names.push_back(name);
+  });
+  EXPECT_EQ(names.size(), 10u);
+  std::ostringstream out {};
+  out << stats;
+  EXPECT_NE(out.str().find("heap_pushes 3\n"), std::string::npos);
+}
+
+// *** Batched multi-source search tests
+
+TEST(batchedTest, tinyBatchOf8) {
+  Graph<int> G {"tinyEWD.txt"};
+  APSPOptions options {};
+  options.sourceBatch = 8;
+  EXPECT_EQ(johnsonAPSPWithOptions(G, options), johnsonAPSP(G));
+}
+
+TEST(batchedTest, mediumBatchOf16) {
+  Graph<double> G {"mediumEWD.txt"};
+  APSPOptions options {};
+  options.sourceBatch = 16;
+  std::vector<std::vector<double> > result =
+      johnsonAPSPWithOptions(G, options);
+  ASSERT_EQ(result.at(0).at(1), 71178);
+  ASSERT_EQ(result.at(1).at(50), 64313);
+  EXPECT_EQ(result, johnsonAPSP(G));
+}
+
+// negative edges and a partial last batch
+TEST(batchedTest, randomPartialBatches) {
+  Graph<int> G = createRandomGraph(203, 5'551'234, 0.03);
+  ASSERT_FALSE(existsNegativeCycle(G));
+  std::vector<std::vector<int> > expected = floydWarshallAPSP(G);
+  APSPOptions options {};
+  options.numThreads = 3;
+  for (int batch : {8, 16}) {
+    options.sourceBatch = batch;
+    EXPECT_EQ(johnsonAPSPWithOptions(G, options), expected);
+  }
+}
+
+// relaxLanes with and without AVX2 from the same lanes, some infinite
+template <typename T, int Batch>
+void expectLanesMatch(unsigned seed) {
+  std::mt19937 mt {seed};
+  std::uniform_int_distribution<int> value {0, 40};
+  std::bernoulli_distribution missing {0.3};
+  for (int trial = 0; trial < 200; ++trial) {
+    T du[Batch];
+    T scalar[Batch];
+    T vector[Batch];
+    for (int b = 0; b < Batch; ++b) {
+      du[b] = missing(mt) ? infinity<T>() : static_cast<T>(value(mt));
+      scalar[b] = vector[b] =
+          missing(mt) ? infinity<T>() : static_cast<T>(value(mt));
+    }
+    T w = static_cast<T>(value(mt));
+    T expected = relaxLanes<Batch>(du, w, scalar, false);
+    ASSERT_EQ(relaxLanes<Batch>(du, w, vector, true), expected);
+    for (int b = 0; b < Batch; ++b) {
+      ASSERT_EQ(vector[b], scalar[b]);
+    }
+  }
+}
+
+TEST(batchedTest, lanesMatchScalar) {
+  int du[8] {};
+  int dv[8] {};
+  std::fill(du, du + 8, infinity<int>());
+  std::fill(dv, dv + 8, infinity<int>());
+  du[0] = infinity<int>() - 3;
+  // saturates at infinity rather than overflowing
+  EXPECT_EQ(relaxLanes<8>(du, 5, dv, false), infinity<int>());
+  EXPECT_EQ(relaxLanes<8>(du, 5, dv, cpuHasAVX2()), infinity<int>());
+  EXPECT_EQ(dv[0], infinity<int>());
+  if (!cpuHasAVX2()) {
+    GTEST_SKIP() << "this CPU has no AVX2";
+  }
+  expectLanesMatch<int, 8>(1);
+  expectLanesMatch<int, 16>(2);
+  expectLanesMatch<float, 8>(3);
+  expectLanesMatch<float, 16>(4);
+  expectLanesMatch<double, 8>(5);
+  expectLanesMatch<double, 16>(6);
+}
+
+TEST(batchedTest, invalidBatchThrows) {
+  Graph<int> G {3};
+  APSPOptions options {};
+  options.sourceBatch = 5;
+  EXPECT_THROW(johnsonAPSPWithOptions(G, options), std::invalid_argument);
+  // options are checked before Bellman-Ford, which would find this cycle
+  G.addEdge(0, 1, -1);
+  G.addEdge(1, 0, -1);
+  EXPECT_THROW(johnsonAPSPWithOptions(G, options), std::invalid_argument);
+  options.sourceBatch = 8;
+  options.reuseFinishedRows = true;
+  EXPECT_THROW(johnsonAPSPWithOptions(G, options), std::invalid_argument);
+}
+
+// *** Min-plus product tests
+
+TEST(minPlusTest, multiplyMatchesDefinition) {
+  const int N = 37;
+  std::mt19937 mt {4'242};
+  std::uniform_int_distribution<int> weight {-5, 50};
+  std::bernoulli_distribution missing {0.3};
+  DistanceMatrix<int> A {N};
+  DistanceMatrix<int> B {N};
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      A(i, j) = missing(mt) ? infinity<int>() : weight(mt);
+      B(i, j) = missing(mt) ? infinity<int>() : weight(mt);
+    }
+  }
+  DistanceMatrix<int> C = minPlusMultiply(A, B);
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      int best = infinity<int>();
+      for (int k = 0; k < N; ++k) {
+        if (A(i, k) != infinity<int>() and B(k, j) != infinity<int>()) {
+          best = std::min(best, A(i, k) + B(k, j));
+        }
+      }
+      ASSERT_EQ(C(i, j), best);
+    }
+  }
+}
+
+TEST(minPlusTest, floatAndDoubleKernels) {
+  const int N = 70;
+  std::mt19937 mt {99};
+  std::uniform_int_distribution<int> weight {0, 20};
+  std::bernoulli_distribution missing {0.5};
+  DistanceMatrix<float> Af {N};
+  DistanceMatrix<double> Ad {N};
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      int w = missing(mt) ? -1 : weight(mt);
+      Af(i, j) = w < 0 ? infinity<float>() : static_cast<float>(w);
+      Ad(i, j) = w < 0 ? infinity<double>() : static_cast<double>(w);
+    }
+  }
+  DistanceMatrix<float> Cf = minPlusMultiply(Af, Af, 2);
+  DistanceMatrix<double> Cd = minPlusMultiply(Ad, Ad, 2);
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      ASSERT_EQ(static_cast<double>(Cf(i, j)), Cd(i, j));
+    }
+  }
+}
+
+#ifdef GRAPH_AVX2
+// the AVX2 tile against the scalar loop on a ragged N x N product with
+// negative and infinite entries in both operands and in C
+template <typename T>
+void expectVectorTileMatchesScalar(int N, unsigned seed) {
+  std::mt19937 mt {seed};
+  std::uniform_int_distribution<int> weight {-9, 60};
+  std::bernoulli_distribution missing {0.3};
+  DistanceMatrix<T> A {N};
+  DistanceMatrix<T> B {N};
+  DistanceMatrix<T> C {N};
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      A(i, j) = missing(mt) ? infinity<T>() : static_cast<T>(weight(mt));
+      B(i, j) = missing(mt) ? infinity<T>() : static_cast<T>(weight(mt));
+      C(i, j) = missing(mt) ? infinity<T>() : static_cast<T>(weight(mt));
+    }
+  }
+  // a row and a column of A and B that are all infinity
+  for (int k = 0; k < N; ++k) {
+    A(1, k) = infinity<T>();
+    B(k, 2) = infinity<T>();
+  }
+  DistanceMatrix<T> vector = C;
+  DistanceMatrix<T> scalar = C;
+  minPlusVectorTile(A, B, vector, 0, N, 0, N, 0, N);
+  minPlusScalarBlock(A, B, scalar, 0, N, 0, N, 0, N);
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      ASSERT_EQ(vector(i, j), scalar(i, j)) << i << ", " << j;
+    }
+  }
+}
+
+TEST(minPlusTest, avx2TileMatchesScalar) {
+  if (!cpuHasAVX2()) {
+    GTEST_SKIP() << "this CPU has no AVX2";
+  }
+  for (int N : {16, 37, 70}) {
+    expectVectorTileMatchesScalar<int>(N, 11 + N);
+    expectVectorTileMatchesScalar<float>(N, 12 + N);
+    expectVectorTileMatchesScalar<double>(N, 13 + N);
+  }
+}
+#endif
+
+TEST(minPlusTest, tinySquaring) {
+  Graph<int> G {"tinyEWD.txt"};
+  EXPECT_EQ(minPlusSquaringAPSP(G), johnsonAPSP(G));
+}
+
+TEST(minPlusTest, mediumSquaring) {
+  Graph<double> G {"mediumEWD.txt"};
+  std::vector<std::vector<double> > result = minPlusSquaringAPSP(G);
+  ASSERT_EQ(result.at(0).at(2), 65237);
+  ASSERT_EQ(result.at(1).at(34), 36489);
+}
+
+TEST(minPlusTest, negativeCycle) {
+  Graph<int> G {4};
+  G.addEdge(0, 1, 1);
+  G.addEdge(1, 2, -2);
+  G.addEdge(2, 3, -1);
+  G.addEdge(3, 0, 1);
+  EXPECT_TRUE(minPlusSquaringAPSP(G).empty());
+  Graph<int> selfLoop {1};
+  selfLoop.addEdge(0, 0, -1);
+  EXPECT_TRUE(minPlusSquaringAPSP(selfLoop).empty());
+}
+
+TEST(minPlusTest, random150) {
+  randomTest(minPlusSquaringAPSP<int>, 150, 2'314'552, 0.05);
+}
+
+TEST(minPlusTest, random300) {
+  randomTest(minPlusSquaringAPSP<int>, 300, 98'982, 0.05);
+}
+
+// *** Hop-limited shortest path tests
+
+// k-hop distances straight from the recurrence, for comparison
+std::vector<std::vector<int> > bruteForceHops(const Graph<int>& G, int k) {
+  int V = G.size();
+  int inf = infinity<int>();
+  std::vector<std::vector<int> > dist(V, std::vector<int>(V, inf));
+  for (int s = 0; s < V; ++s) {
+    dist[s][s] = 0;
+    for (int round = 0; round < k; ++round) {
+      std::vector<int> next = dist[s];
+      for (int u = 0; u < V; ++u) {
+        if (dist[s][u] == inf) {
+          continue;
+        }
+        for (const auto& [v, w] : G.neighbours(u)) {
+          next[v] = std::min(next[v], dist[s][u] + w);
+        }
+      }
+      dist[s] = next;
+    }
+  }
+  return dist;
+}
+
+TEST(boundedHopTest, hopLimitChangesAnswer) {
+  Graph<int> G {4};
+  G.addEdge(0, 3, 10);
+  G.addEdge(0, 1, 1);
+  G.addEdge(1, 2, 1);
+  G.addEdge(2, 3, 1);
+  int inf = infinity<int>();
+  EXPECT_EQ(boundedHopSSSP(G, 0, 0), (std::vector<int> {0, inf, inf, inf}));
+  EXPECT_EQ(boundedHopSSSP(G, 0, 1).at(3), 10);
+  EXPECT_EQ(boundedHopSSSP(G, 0, 2).at(3), 10);
+  EXPECT_EQ(boundedHopSSSP(G, 0, 3).at(3), 3);
+  EXPECT_EQ(boundedHopAPSP(G, 2).at(0).at(2), 2);
+  EXPECT_EQ(boundedHopAPSP(G, 1).at(0).at(2), inf);
+}
+
+TEST(boundedHopTest, negativeCycleStaysFinite) {
+  Graph<int> G {2};
+  G.addEdge(0, 1, 1);
+  G.addEdge(1, 0, -3);
+  std::vector<std::vector<int> > result = boundedHopAPSP(G, 3);
+  EXPECT_EQ(result.at(0).at(0), -2);
+  EXPECT_EQ(result.at(0).at(1), -1);
+  EXPECT_EQ(boundedHopSSSP(G, 0, 3), result.at(0));
+}
+
+TEST(boundedHopTest, randomMatchesRecurrence) {
+  Graph<int> G = createRandomGraph(90, 1'234'987, 0.05);
+  APSPOptions options {};
+  options.numThreads = 3;
+  for (int k : {0, 1, 2, 5}) {
+    std::vector<std::vector<int> > expected = bruteForceHops(G, k);
+    ASSERT_EQ(boundedHopAPSP(G, k, options), expected);
+    for (int s : {0, 17, 89}) {
+      ASSERT_EQ(boundedHopSSSP(G, s, k, options), expected.at(s));
+    }
+  }
+}
+
+TEST(boundedHopTest, enoughHopsIsUnbounded) {
+  Graph<int> G {"tinyEWD.txt"};
+  EXPECT_EQ(boundedHopAPSP(G, G.size() - 1), johnsonAPSP(G));
+  Graph<int> R = createRandomGraph(120, 3'635'050'020, 0.15);
+  ASSERT_FALSE(existsNegativeCycle(R));
+  EXPECT_EQ(boundedHopAPSP(R, R.size() - 1), floydWarshallAPSP(R));
+}
+
+TEST(boundedHopTest, invalidArguments) {
+  Graph<int> G {3};
+  EXPECT_THROW(boundedHopAPSP(G, -1), std::invalid_argument);
+  EXPECT_THROW(boundedHopSSSP(G, 3, 1), std::out_of_range);
+}
+
+// *** Result verification tests
+
+TEST(verifyTest, acceptsEngineResults) {
+  Graph<int> G = createRandomGraph(100, 2'495'118'394, 0.15);
+  ASSERT_FALSE(existsNegativeCycle(G));
+  APSPOptions options {};
+  options.numThreads = 3;
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  EXPECT_TRUE(verifyAPSP(G, result));
+  EXPECT_TRUE(verifyAPSP(G, result, 0, options));
+  EXPECT_TRUE(verifyAPSP(G, DistanceMatrix<int> {result}));
+}
+
+TEST(verifyTest, acceptsUnreachable) {
+  Graph<double> G {"mediumEWD.txt"};
+  EXPECT_TRUE(verifyAPSP(G, johnsonAPSP(G)));
+  Graph<int> sparse = createRandomGraph(60, 11, 0.01);
+  EXPECT_TRUE(verifyAPSP(sparse, floydWarshallAPSP(sparse)));
+}
+
+TEST(verifyTest, rejectsTooSmallEntry) {
+  Graph<int> G {"tinyEWD.txt"};
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  result[5][3] -= 1;
+  APSPVerification check = verifyAPSP(G, result);
+  EXPECT_FALSE(check);
+  EXPECT_EQ(check.defect, APSPDefect::noTightEdge);
+  EXPECT_EQ(check.source, 5);
+}
+
+TEST(verifyTest, rejectsTooLargeEntry) {
+  Graph<int> G {"tinyEWD.txt"};
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  result[6][2] += 1;
+  APSPVerification check = verifyAPSP(G, result);
+  EXPECT_EQ(check.defect, APSPDefect::edgeNotRelaxed);
+  EXPECT_EQ(check.source, 6);
+  EXPECT_EQ(check.vertex, 2);
+}
+
+TEST(verifyTest, rejectsInfinityForReachable) {
+  Graph<int> G {"tinyEWD.txt"};
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  result[4][7] = infinity<int>();
+  APSPVerification check = verifyAPSP(G, result);
+  EXPECT_FALSE(check);
+  EXPECT_EQ(check.source, 4);
+}
+
+TEST(verifyTest, rejectsFiniteForUnreachable) {
+  Graph<int> G {3};
+  G.addEdge(0, 1, 2);
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  result[0][2] = 7;
+  EXPECT_EQ(verifyAPSP(G, result).defect, APSPDefect::noTightEdge);
+}
+
+TEST(verifyTest, rejectsBadDiagonalAndShape) {
+  Graph<int> G {"tinyEWD.txt"};
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  result[3][3] = -1;
+  APSPVerification check = verifyAPSP(G, result);
+  EXPECT_EQ(check.defect, APSPDefect::nonZeroDiagonal);
+  EXPECT_EQ(check.source, 3);
+  result.pop_back();
+  EXPECT_EQ(verifyAPSP(G, result).defect, APSPDefect::wrongShape);
+}
+
+TEST(verifyTest, rejectsNaN) {
+  Graph<double> G {"tinyEWD.txt"};
+  std::vector<std::vector<double> > result = johnsonAPSP(G);
+  result[2][4] = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_EQ(verifyAPSP(G, result).defect, APSPDefect::invalidEntry);
+}
+
+TEST(verifyTest, reportsSmallestSource) {
+  Graph<int> G = createRandomGraph(100, 340'189'135, 0.15);
+  std::vector<std::vector<int> > result = johnsonAPSP(G);
+  result[90][10] += 1000;
+  result[40][11] += 1000;
+  APSPOptions options {};
+  options.numThreads = 4;
+  EXPECT_EQ(verifyAPSP(G, result, 0, options).source, 40);
+}
+
+TEST(verifyTest, toleranceForFloatingPoint) {
+  Graph<double> G {"tinyEWD.txt"};
+  std::vector<std::vector<double> > result = johnsonAPSP(G);
+  result[1][6] += 1e-9;
+  EXPECT_FALSE(verifyAPSP(G, result));
+  EXPECT_TRUE(verifyAPSP(G, result, 1e-6));
+}
+
+// *** Random graph generator tests
+
+// is every row of G sorted by target without repeats?
+template <typename T>
+bool rowsStrictlySorted(const CSRGraph<T>& G) {
+  for (int v = 0; v < G.size(); ++v) {
+    for (int e = G.offsets[v] + 1; e < G.offsets[v + 1]; ++e) {
+      if (G.targets[e - 1] >= G.targets[e]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <typename T>
+bool sameCSR(const CSRGraph<T>& A, const CSRGraph<T>& B) {
+  return A.offsets == B.offsets and A.targets == B.targets and
+         A.weights == B.weights;
+}
+
+TEST(generatorTest, erdosRenyiIndependentOfThreads) {
+  GeneratorOptions one {};
+  one.numThreads = 1;
+  GeneratorOptions four {};
+  four.numThreads = 4;
+  CSRGraph<int> A = erdosRenyiGraph(3000, 0.002, 42, -1, 100, one);
+  CSRGraph<int> B = erdosRenyiGraph(3000, 0.002, 42, -1, 100, four);
+  EXPECT_TRUE(sameCSR(A, B));
+  EXPECT_TRUE(rowsStrictlySorted(A));
+  CSRGraph<int> C = erdosRenyiGraph(3000, 0.002, 43, -1, 100, one);
+  EXPECT_FALSE(sameCSR(A, C));
+}
+
+TEST(generatorTest, erdosRenyiDensity) {
+  CSRGraph<int> G = erdosRenyiGraph(2000, 0.01, 7, 0, 10);
+  // 40000 expected edges with a standard deviation of about 200
+  EXPECT_NEAR(static_cast<double>(G.numEdges()), 40'000, 1'500);
+  for (int w : G.weights) {
+    ASSERT_TRUE(w >= 0 and w <= 10);
+  }
+  EXPECT_EQ(erdosRenyiGraph(50, 0.0, 7, 0, 10).numEdges(), 0u);
+  EXPECT_EQ(erdosRenyiGraph(50, 1.0, 7, 0, 10).numEdges(), 2'500u);
+}
+
+TEST(generatorTest, extremeRanges) {
+  // weight spans wider than INT_MAX and the full range of long long
+  const long long lowest = std::numeric_limits<long long>::min();
+  const long long highest = std::numeric_limits<long long>::max();
+  CSRGraph<long long> wide = erdosRenyiGraph(30, 1.0, 5, lowest / 2,
+                                             highest / 2);
+  CSRGraph<long long> full = erdosRenyiGraph(30, 1.0, 5, lowest, highest);
+  bool negative = false;
+  for (long long w : wide.weights) {
+    ASSERT_TRUE(w >= lowest / 2 and w <= highest / 2);
+    negative = negative or w < 0;
+  }
+  EXPECT_TRUE(negative);
+  EXPECT_EQ(full.numEdges(), 900u);
+  // skips far beyond LLONG_MAX end every row
+  EXPECT_EQ(erdosRenyiGraph(1000, 1e-300, 7, 0, 10).numEdges(), 0u);
+}
+
+TEST(generatorTest, erdosRenyiWithoutSelfLoops) {
+  GeneratorOptions options {};
+  options.selfLoops = false;
+  CSRGraph<double> G = erdosRenyiGraph(40, 1.0, 3, 0.5, 2.5, options);
+  EXPECT_EQ(G.numEdges(), 40u * 39u);
+  for (int v = 0; v < G.size(); ++v) {
+    for (int e = G.offsets[v]; e < G.offsets[v + 1]; ++e) {
+      ASSERT_NE(G.targets[e], v);
+      ASSERT_TRUE(G.weights[e] >= 0.5 and G.weights[e] <= 2.5);
+    }
+  }
+}
+
+TEST(generatorTest, rmatIsSkewed) {
+  GeneratorOptions options {};
+  options.numThreads = 3;
+  CSRGraph<int> G = rmatGraph(12, 40'000, 5, 1, 9, 0.57, 0.19, 0.19,
+                              options);
+  EXPECT_EQ(G.size(), 4096);
+  EXPECT_LE(G.numEdges(), 40'000u);
+  EXPECT_TRUE(rowsStrictlySorted(G));
+  int maxDegree = 0;
+  for (int v = 0; v < G.size(); ++v) {
+    maxDegree = std::max(maxDegree, G.offsets[v + 1] - G.offsets[v]);
+  }
+  // average degree is under 10; a power law has hubs far above it
+  EXPECT_GT(maxDegree, 100);
+  CSRGraph<int> again = rmatGraph(12, 40'000, 5, 1, 9);
+  EXPECT_TRUE(sameCSR(G, again));
+}
+
+TEST(generatorTest, gridShape) {
+  CSRGraph<int> G = gridGraph(3, 4, 11, 1, 5);
+  EXPECT_EQ(G.size(), 12);
+  // 2 * (3 * 3 + 2 * 4) directed edges
+  EXPECT_EQ(G.numEdges(), 34u);
+  EXPECT_TRUE(rowsStrictlySorted(G));
+  EXPECT_EQ(G.offsets[1] - G.offsets[0], 2);
+  EXPECT_EQ(G.offsets[6] - G.offsets[5], 4);
+}
+
+TEST(generatorTest, generatedGraphsSolve) {
+  Graph<int> grid = toGraph(gridGraph(12, 15, 99, 1, 20));
+  EXPECT_TRUE(verifyAPSP(grid, johnsonAPSP(grid)));
+  Graph<int> sparse = toGraph(erdosRenyiGraph(300, 0.02, 1, 0, 100));
+  EXPECT_TRUE(verifyAPSP(sparse, floydWarshallAPSP(sparse)));
+  EXPECT_EQ(sparse.numEdges(), erdosRenyiGraph(300, 0.02, 1, 0, 100)
+                                   .numEdges());
+}
+
+TEST(reachabilityTest, chainAndCycle) {
+  // 0 -> 1 -> 2 <-> 3, and 4 on its own
+  Graph<int> G {5};
+  G.addEdge(0, 1, 7);
+  G.addEdge(1, 2, -3);
+  G.addEdge(2, 3, 1);
+  G.addEdge(3, 2, -5);
+  ReachabilityMatrix R = reachabilityMatrix(G);
+  EXPECT_EQ(R.size(), 5);
+  EXPECT_TRUE(R.reachable(0, 3));
+  EXPECT_TRUE(R.reachable(3, 2));
+  EXPECT_TRUE(R.reachable(4, 4));
+  EXPECT_FALSE(R.reachable(3, 1));
+  EXPECT_FALSE(R.reachable(0, 4));
+  EXPECT_EQ(R.count(0), 4);
+  EXPECT_EQ(R.count(2), 2);
+  EXPECT_EQ(R.count(4), 1);
+}
+
+TEST(reachabilityTest, matchesDistances) {
+  for (unsigned seed : {3u, 17u, 2024u}) {
+    // sparse enough to leave several components, and wider than one word
+    Graph<int> G = toGraph(erdosRenyiGraph(150, 0.008, seed, 0, 50));
+    DistanceMatrix<int> D {johnsonAPSP(G)};
+    APSPOptions options {};
+    options.numThreads = 4;
+    EXPECT_EQ(reachabilityMatrix(G, options), reachabilityOf(D));
+    EXPECT_EQ(reachabilityMatrix(G), reachabilityOf(D));
+  }
+}
+
+TEST(reachabilityTest, ignoresNegativeCycles) {
+  Graph<int> G {3};
+  G.addEdge(0, 1, -2);
+  G.addEdge(1, 0, 1);
+  G.addEdge(1, 2, 4);
+  ASSERT_TRUE(existsNegativeCycle(G));
+  ReachabilityMatrix R = reachabilityMatrix(G);
+  EXPECT_TRUE(R.reachable(1, 2));
+  EXPECT_TRUE(R.reachable(1, 0));
+  EXPECT_FALSE(R.reachable(2, 0));
+  EXPECT_TRUE(reachabilityMatrix(Graph<int> {0}).empty());
+}
+
+TEST(versionedTest, snapshotsAreIsolated) {
+  VersionedGraph<int> graph {130};
+  graph.addEdge(0, 1, 5);
+  auto before = graph.snapshot();
+  EXPECT_EQ(graph.addEdge(1, 2, 3), 2u);
+  EXPECT_EQ(graph.removeEdge(0, 1), 3u);
+  auto after = graph.snapshot();
+  EXPECT_EQ(before->version(), 1u);
+  EXPECT_TRUE(before->isEdge(0, 1));
+  EXPECT_FALSE(before->isEdge(1, 2));
+  EXPECT_EQ(before->numEdges(), 1u);
+  EXPECT_FALSE(after->isEdge(0, 1));
+  EXPECT_EQ(after->getEdgeWeight(1, 2), 3);
+  EXPECT_EQ(after->numEdges(), 1u);
+  EXPECT_THROW(graph.addEdge(0, 130, 1), std::out_of_range);
+  EXPECT_THROW(after->neighbours(-1), std::out_of_range);
+}
+
+TEST(versionedTest, untouchedRowsAreShared) {
+  Graph<int> G = createRandomGraph(200, 77, 0.05);
+  VersionedGraph<int> graph {G};
+  auto before = graph.snapshot();
+  EXPECT_EQ(before->version(), 0u);
+  EXPECT_EQ(before->numEdges(), G.numEdges());
+  graph.update([](VersionedGraph<int>::Writer& writer) {
+    writer.addEdge(3, 150, -4);
+    writer.removeEdge(3, 150);
+    writer.addEdge(3, 150, 9);
+  });
+  auto after = graph.snapshot();
+  EXPECT_EQ(after->version(), 1u);
+  EXPECT_EQ(after->getEdgeWeight(3, 150), 9);
+  EXPECT_NE(&before->neighbours(3), &after->neighbours(3));
+  EXPECT_EQ(&before->neighbours(4), &after->neighbours(4));
+  EXPECT_EQ(&before->neighbours(199), &after->neighbours(199));
+}
+
+TEST(versionedTest, failedUpdatePublishesNothing) {
+  VersionedGraph<int> graph {4};
+  EXPECT_THROW(graph.update([](VersionedGraph<int>::Writer& writer) {
+                 writer.addEdge(0, 1, 1);
+                 writer.addEdge(0, 9, 1);
+               }),
+               std::out_of_range);
+  EXPECT_EQ(graph.snapshot()->version(), 0u);
+  EXPECT_EQ(graph.snapshot()->numEdges(), 0u);
+}
+
+TEST(versionedTest, readersRunWhileWriting) {
+  // non-negative weights, so every version has an answer
+  Graph<int> G = toGraph(erdosRenyiGraph(60, 0.1, 5, 0, 20));
+  VersionedGraph<int> graph {G};
+  std::atomic<bool> done {false};
+  std::thread writer {[&]() {
+    std::mt19937 gen {9};
+    std::uniform_int_distribution<int> vertex {0, 59};
+    std::uniform_int_distribution<int> weight {0, 20};
+    while (!done) {
+      graph.update([&](VersionedGraph<int>::Writer& edits) {
+        for (int i = 0; i < 5; ++i) {
+          edits.addEdge(vertex(gen), vertex(gen), weight(gen));
+          edits.removeEdge(vertex(gen), vertex(gen));
+        }
+      });
+    }
+  }};
+  for (int job = 0; job < 20; ++job) {
+    auto snapshot = graph.snapshot();
+    Graph<int> H = toGraph(*snapshot);
+    // the snapshot must not move under the job
+    EXPECT_EQ(H.numEdges(), snapshot->numEdges());
+    EXPECT_TRUE(verifyAPSP(H, johnsonAPSP(H)));
+    EXPECT_EQ(toGraph(*snapshot).numEdges(), snapshot->numEdges());
+  }
+  done = true;
+  writer.join();
+  EXPECT_GT(graph.snapshot()->version(), 0u);
+}
+
+TEST(asyncTest, jobsMatchBlockingCalls) {
+  Graph<int> G = createRandomGraph(80, 31, 0.1);
+  APSPJob<int> johnson {G, APSPAlgorithm::johnson};
+  APSPJob<int> floyd {G, APSPAlgorithm::floydWarshall};
+  APSPJobResult<int> a = johnson.get();
+  APSPJobResult<int> b = floyd.get();
+  EXPECT_FALSE(a.cancelled or a.negativeCycle);
+  EXPECT_EQ(a.rows, johnsonAPSP(G));
+  EXPECT_EQ(b.rows, floydWarshallAPSP(G));
+  EXPECT_EQ(johnson.progress().completed, 80);
+  EXPECT_EQ(floyd.progress().completed, 80);
+  EXPECT_EQ(floyd.progress().total, 80);
+  // the result has been taken, so there is nothing left to wait for
+  EXPECT_TRUE(johnson.ready());
+  johnson.wait();
+}
+
+TEST(asyncTest, stopBeforeStart) {
+  Graph<int> G = toGraph(erdosRenyiGraph(50, 0.1, 8, 0, 100));
+  std::stop_source stop {};
+  stop.request_stop();
+  APSPOptions options {};
+  options.stopToken = stop.get_token();
+  auto johnson = johnsonAPSPWithOptions(G, options);
+  auto floyd = floydWarshallAPSPWithOptions(G, options);
+  ASSERT_EQ(johnson.size(), 50u);
+  ASSERT_EQ(floyd.size(), 50u);
+  for (int s = 0; s < 50; ++s) {
+    EXPECT_TRUE(johnson[s].empty());
+    EXPECT_TRUE(floyd[s].empty());
+  }
+}
+
+TEST(asyncTest, cancelKeepsFinishedRows) {
+  Graph<int> G = toGraph(erdosRenyiGraph(2000, 0.002, 12, 0, 100));
+  APSPOptions options {};
+  options.numThreads = 1;
+  APSPJob<int> job {G, APSPAlgorithm::johnson, options};
+  while (job.progress().completed == 0 and !job.ready()) {
+    std::this_thread::yield();
+  }
+  job.cancel();
+  APSPJobResult<int> result = job.get();
+  EXPECT_TRUE(result.cancelled);
+  EXPECT_FALSE(result.negativeCycle);
+  ASSERT_EQ(result.rows.size(), 2000u);
+  EXPECT_GE(result.completedRows(), 1);
+  EXPECT_LT(result.completedRows(), 2000);
+  EXPECT_EQ(result.completedRows(), job.progress().completed);
+  auto expected = johnsonAPSP(G);
+  for (int s = 0; s < 2000; ++s) {
+    if (!result.rows[s].empty()) {
+      ASSERT_EQ(result.rows[s], expected[s]);
+    }
+  }
+}
+
+TEST(asyncTest, failuresAreReported) {
+  Graph<int> G {3};
+  G.addEdge(0, 1, -2);
+  G.addEdge(1, 0, 1);
+  APSPJob<int> cycle {G, APSPAlgorithm::floydWarshall};
+  APSPJobResult<int> result = cycle.get();
+  EXPECT_TRUE(result.negativeCycle);
+  EXPECT_FALSE(result.cancelled);
+  APSPOptions options {};
+  options.sourceBatch = 3;
+  APSPJob<int> invalid {createRandomGraph(10, 1), APSPAlgorithm::johnson,
+                        options};
+  EXPECT_THROW(invalid.get(), std::invalid_argument);
+  // destroying a running job cancels it
+  APSPJob<int> abandoned {toGraph(erdosRenyiGraph(3000, 0.002, 4, 0, 9)),
+                          APSPAlgorithm::johnson};
+}
+
+// checkpoint file in the temporary directory, removed before use
+std::string checkpointPath(const std::string& name) {
+  std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove(path);
+  return path.string();
+}
+
+TEST(checkpointTest, johnsonResumesFromPartialFile) {
+  GeneratorOptions noLoops {};
+  noLoops.selfLoops = false;
+  Graph<int> G = toGraph(erdosRenyiGraph(70, 0.08, 6, -1, 100, noLoops));
+  auto expected = johnsonAPSP(G);
+  ASSERT_FALSE(expected.empty());
+  CheckpointOptions checkpoint {checkpointPath("apsp_johnson.ckpt"),
+                                std::chrono::milliseconds {0}};
+  // stopped before the first source: only the potentials are saved
+  std::stop_source stop {};
+  stop.request_stop();
+  APSPOptions stopped {};
+  stopped.stopToken = stop.get_token();
+  auto none = johnsonAPSPCheckpointed(G, checkpoint, stopped);
+  ASSERT_EQ(none.size(), 70u);
+  EXPECT_TRUE(none[0].empty());
+  std::uintmax_t prefix = std::filesystem::file_size(checkpoint.path);
+
+  EXPECT_EQ(johnsonAPSPCheckpointed(G, checkpoint), expected);
+  std::uintmax_t full = std::filesystem::file_size(checkpoint.path);
+  std::uintmax_t record = sizeof(std::int32_t) + 70 * sizeof(int);
+  EXPECT_EQ(full, prefix + 70 * record);
+  // a crash in the middle of the fifth record
+  std::filesystem::resize_file(checkpoint.path, prefix + 4 * record + 9);
+  std::atomic<int> progress {0};
+  APSPOptions options {};
+  options.progress = &progress;
+  EXPECT_EQ(johnsonAPSPCheckpointed(G, checkpoint, options), expected);
+  EXPECT_EQ(progress, 70);
+  EXPECT_EQ(std::filesystem::file_size(checkpoint.path), full);
+  // a finished file is just read back
+  EXPECT_EQ(johnsonAPSPCheckpointed(G, checkpoint), expected);
+  EXPECT_EQ(std::filesystem::file_size(checkpoint.path), full);
+  std::filesystem::remove(checkpoint.path);
+}
+
+TEST(checkpointTest, floydWarshallResumesAfterCancel) {
+  Graph<int> G = toGraph(erdosRenyiGraph(60, 0.08, 3, 0, 100));
+  auto expected = floydWarshallAPSP(G);
+  CheckpointOptions checkpoint {checkpointPath("apsp_floyd.ckpt"),
+                                std::chrono::minutes {5}};
+  std::stop_source stop {};
+  stop.request_stop();
+  APSPOptions stopped {};
+  stopped.stopToken = stop.get_token();
+  auto none = floydWarshallAPSPCheckpointed(G, checkpoint, stopped);
+  ASSERT_EQ(none.size(), 60u);
+  EXPECT_TRUE(none[0].empty());
+  ASSERT_TRUE(std::filesystem::exists(checkpoint.path));
+  std::atomic<int> progress {0};
+  APSPOptions options {};
+  options.progress = &progress;
+  EXPECT_EQ(floydWarshallAPSPCheckpointed(G, checkpoint, options), expected);
+  EXPECT_EQ(progress, 60);
+  EXPECT_EQ(floydWarshallAPSPCheckpointed(G, checkpoint), expected);
+  std::filesystem::remove(checkpoint.path);
+}
+
+TEST(checkpointTest, rejectsOtherGraphs) {
+  Graph<int> G = toGraph(erdosRenyiGraph(30, 0.1, 2, 0, 9));
+  CheckpointOptions checkpoint {checkpointPath("apsp_other.ckpt")};
+  johnsonAPSPCheckpointed(G, checkpoint);
+  G.addEdge(0, 29, 1);
+  EXPECT_THROW(johnsonAPSPCheckpointed(G, checkpoint), std::invalid_argument);
+  EXPECT_THROW(floydWarshallAPSPCheckpointed(G, checkpoint),
+               std::invalid_argument);
+  Graph<double> H = toGraph(erdosRenyiGraph(30, 0.1, 2, 0.0, 9.0));
+  EXPECT_THROW(johnsonAPSPCheckpointed(H, checkpoint), std::invalid_argument);
+  std::filesystem::remove(checkpoint.path);
+}
+
+TEST(compressedTest, roundTripsDistances) {
+  // several components, so rows mix finite and infinite blocks
+  Graph<int> G = toGraph(erdosRenyiGraph(300, 0.004, 19, 0, 1000));
+  DistanceMatrix<int> D {johnsonAPSP(G)};
+  CompressedDistanceMatrix<int> C {D, 3};
+  EXPECT_EQ(C.size(), 300);
+  EXPECT_EQ(C.decompress(), D);
+  for (int i = 0; i < 300; i += 7) {
+    for (int j = 0; j < 300; ++j) {
+      ASSERT_EQ(C(i, j), D(i, j));
+    }
+  }
+  EXPECT_LT(C.bytes(), 300u * 300u * sizeof(int) / 2);
+  EXPECT_EQ(CompressedDistanceMatrix<int> {johnsonAPSP(G)}.row(5),
+            std::vector<int>(D.row(5), D.row(5) + 300));
+}
+
+TEST(compressedTest, extremeValues) {
+  const long long inf = infinity<long long>();
+  const long long low = std::numeric_limits<long long>::min();
+  std::vector<std::vector<long long> > rows {
+      {0, inf, low, inf - 1, 5},
+      {inf, inf, inf, inf, inf},
+      {7, 7, 7, 7, 7},
+      {-3, inf, -3, inf, -2},
+      {low, low + 1, inf, 0, 1}};
+  CompressedDistanceMatrix<long long> C {rows};
+  EXPECT_EQ(C.decompress().toRows(), rows);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      ASSERT_EQ(C(i, j), rows[i][j]);
+    }
+  }
+  std::vector<std::vector<short> > narrow(130, std::vector<short>(130));
+  for (int i = 0; i < 130; ++i) {
+    for (int j = 0; j < 130; ++j) {
+      narrow[i][j] = static_cast<short>((i * 131 + j * 977) % 65535 - 32767);
+    }
+  }
+  EXPECT_EQ(CompressedDistanceMatrix<short> {narrow}.decompress().toRows(),
+            narrow);
+  EXPECT_TRUE(CompressedDistanceMatrix<int> {DistanceMatrix<int> {}}.empty());
+  EXPECT_THROW(CompressedDistanceMatrix<int>(
+                   std::vector<std::vector<int> > {{0, 1}, {0}}),
+               std::invalid_argument);
+}
+
+TEST(compressedTest, everyWidth) {
+  // row r spans 2^(r + 1) - 1 above its base, so the 64 rows of full
+  // blocks cover widths 1 to 64; odd rows also hold infinity
+  const long long inf = infinity<long long>();
+  const long long low = std::numeric_limits<long long>::min();
+  std::mt19937_64 mt {23};
+  std::vector<std::vector<long long> > rows(64, std::vector<long long>(64));
+  for (int r = 0; r < 64; ++r) {
+    std::uint64_t mask = r == 63 ? ~std::uint64_t {1}
+                                 : (std::uint64_t {2} << r) - 1;
+    for (int j = 0; j < 64; ++j) {
+      std::uint64_t code = j == 0 ? 0 : j == 1 ? mask : mt() & mask;
+      rows[r][j] = static_cast<long long>(static_cast<std::uint64_t>(low) +
+                                          code);
+    }
+    if (r % 2 == 1) {
+      rows[r][5] = inf;
+    }
+  }
+  CompressedDistanceMatrix<long long> C {rows};
+  EXPECT_EQ(C.decompress().toRows(), rows);
+  for (int r = 0; r < 64; ++r) {
+    ASSERT_EQ(C.row(r), rows[r]);
+    for (int j = 0; j < 64; ++j) {
+      ASSERT_EQ(C(r, j), rows[r][j]);
+    }
+  }
+}
+
+TEST(landmarkTest, boundsAndExactDistances) {
+  GeneratorOptions noLoops {};
+  noLoops.selfLoops = false;
+  // negative weights and unreachable pairs
+  Graph<int> G = toGraph(erdosRenyiGraph(150, 0.02, 23, -1, 60, noLoops));
+  auto expected = johnsonAPSP(G);
+  ASSERT_FALSE(expected.empty());
+  APSPOptions options {};
+  options.numThreads = 3;
+  LandmarkIndex<int> index {G, 6, 1, options};
+  EXPECT_EQ(index.landmarks().size(), 6u);
+  LandmarkSearch<int> search {150};
+  for (int s = 0; s < 150; ++s) {
+    for (int t = 0; t < 150; ++t) {
+      LandmarkBounds<int> bounds = index.bounds(s, t);
+      int d = expected[s][t];
+      if (d == infinity<int>()) {
+        ASSERT_EQ(bounds.upper, infinity<int>());
+      } else {
+        ASSERT_LE(bounds.lower, d);
+        ASSERT_GE(bounds.upper, d);
+      }
+      ASSERT_EQ(index.distance(s, t, search), d);
+    }
+  }
+  EXPECT_THROW(index.bounds(0, 150), std::out_of_range);
+}
+
+TEST(landmarkTest, altSettlesLessThanDijkstra) {
+  Graph<int> G = toGraph(gridGraph(40, 40, 8, 1, 10));
+  LandmarkIndex<int> index {G, 8, 3};
+  LandmarkSearch<int> search {G.size()};
+  auto fromCorner = johnsonAPSP(G)[0];
+  int settled = 0;
+  for (int t = 1; t < G.size(); t += 37) {
+    ASSERT_EQ(index.distance(0, t, search), fromCorner[t]);
+    settled += search.settled();
+  }
+  // plain Dijkstra to the same targets settles about half the grid each
+  EXPECT_LT(settled, 44 * G.size() / 4);
+}
+
+TEST(landmarkTest, savesAndLoads) {
+  Graph<double> G = toGraph(erdosRenyiGraph(80, 0.05, 4, 0.5, 9.5));
+  LandmarkIndex<double> index {G, 4, 9};
+  std::string path = checkpointPath("apsp_landmarks.idx");
+  index.save(path);
+  LandmarkIndex<double> loaded = LandmarkIndex<double>::load(path, G);
+  EXPECT_EQ(loaded.landmarks(), index.landmarks());
+  for (int s = 0; s < 80; s += 3) {
+    for (int t = 0; t < 80; t += 5) {
+      ASSERT_EQ(loaded.bounds(s, t).lower, index.bounds(s, t).lower);
+      ASSERT_EQ(loaded.distance(s, t), index.distance(s, t));
+    }
+  }
+  G.addEdge(0, 79, 0.25);
+  EXPECT_THROW(LandmarkIndex<double>::load(path, G), std::invalid_argument);
+  std::filesystem::remove(path);
+  Graph<int> cycle {2};
+  cycle.addEdge(0, 1, -3);
+  cycle.addEdge(1, 0, 1);
+  EXPECT_THROW((LandmarkIndex<int> {cycle, 1}), std::invalid_argument);
+}
+
+TEST(contractionTest, queriesMatchDijkstra) {
+  Graph<double> road {"mediumEWD.txt"};
+  ContractionHierarchy<double> ch {road};
+  auto expected = johnsonAPSP(road);
+  ContractionHierarchy<double>::Search search {road.size()};
+  for (int s = 0; s < road.size(); ++s) {
+    for (int t = 0; t < road.size(); ++t) {
+      ASSERT_NEAR(ch.distance(s, t, search), expected[s][t], 1e-9);
+    }
+  }
+  Graph<int> sparse = toGraph(erdosRenyiGraph(200, 0.015, 6, 0, 30));
+  ContractionHierarchy<int> sparseCH {sparse};
+  EXPECT_EQ(sparseCH.manyToMany(std::vector<int>(0), {1, 2}).size(), 0u);
+  std::vector<int> all(200);
+  std::iota(all.begin(), all.end(), 0);
+  EXPECT_EQ(sparseCH.manyToMany(all, all, 3), johnsonAPSP(sparse));
+}
+
+TEST(contractionTest, tablesAndSearchSpace) {
+  Graph<int> grid = toGraph(gridGraph(30, 30, 2, 1, 9));
+  ContractionHierarchy<int> ch {grid};
+  auto expected = johnsonAPSP(grid);
+  std::vector<int> sources {0, 17, 450, 899};
+  std::vector<int> targets {5, 899, 0, 333, 333};
+  auto table = ch.manyToMany(sources, targets, 2);
+  for (std::size_t i = 0; i < sources.size(); ++i) {
+    for (std::size_t j = 0; j < targets.size(); ++j) {
+      ASSERT_EQ(table[i][j], expected[sources[i]][targets[j]]);
+    }
+  }
+  EXPECT_EQ(ch.oneToMany(17, targets), table[1]);
+  ContractionHierarchy<int>::Search search {grid.size()};
+  EXPECT_EQ(ch.distance(0, 899, search), expected[0][899]);
+  // corner to corner Dijkstra settles the whole grid
+  EXPECT_LT(search.settled(), grid.size() / 2);
+  EXPECT_THROW(ch.distance(0, 900), std::out_of_range);
+  Graph<int> negative {2};
+  negative.addEdge(0, 1, -1);
+  EXPECT_THROW(ContractionHierarchy<int> {negative}, std::invalid_argument);
+}
+
+TEST(bidirectionalTest, matchesJohnson) {
+  Graph<double> road {"mediumEWD.txt"};
+  BidirectionalDijkstra<double> query {road};
+  auto expected = johnsonAPSP(road);
+  BidirectionalSearch<double> search {road.size()};
+  for (int s = 0; s < road.size(); ++s) {
+    for (int t = 0; t < road.size(); ++t) {
+      ASSERT_NEAR(query.distance(s, t, search), expected[s][t], 1e-9);
+    }
+  }
+  // negative weights, some pairs unreachable
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  Graph<int> sparse = toGraph(erdosRenyiGraph(150, 0.01, 4, 0, 40, noLoops));
+  sparse.addEdge(3, 7, -5);
+  sparse.addEdge(7, 9, -2);
+  auto rows = johnsonAPSP(sparse);
+  ASSERT_FALSE(rows.empty());
+  BidirectionalDijkstra<int> sparseQuery {sparse};
+  BidirectionalSearch<int> sparseSearch {sparse.size()};
+  for (int s = 0; s < sparse.size(); ++s) {
+    for (int t = 0; t < sparse.size(); ++t) {
+      ASSERT_EQ(sparseQuery.distance(s, t, sparseSearch), rows[s][t]);
+    }
+  }
+}
+
+TEST(bidirectionalTest, searchSpaceAndErrors) {
+  Graph<int> grid = toGraph(gridGraph(40, 40, 3, 1, 9));
+  BidirectionalDijkstra<int> query {grid};
+  auto expected = johnsonAPSP(grid);
+  BidirectionalSearch<int> search {grid.size()};
+  EXPECT_EQ(query.distance(0, 41, search), expected[0][41]);
+  // two small balls instead of one covering the whole grid
+  EXPECT_LT(search.settled(), grid.size() / 10);
+  std::vector<int> zero(grid.size(), 0);
+  BidirectionalDijkstra<int> reused {grid, zero};
+  EXPECT_EQ(reused.distance(5, 1234), expected[5][1234]);
+  EXPECT_THROW(query.distance(0, grid.size()), std::out_of_range);
+  EXPECT_THROW((BidirectionalDijkstra<int> {grid, {1, 2}}),
+               std::invalid_argument);
+  Graph<int> cycle {2};
+  cycle.addEdge(0, 1, -3);
+  cycle.addEdge(1, 0, 1);
+  EXPECT_THROW(BidirectionalDijkstra<int> {cycle}, std::invalid_argument);
+}
+
+TEST(inNeighboursTest, matchesTranspose) {
+  Graph<int> G = toGraph(erdosRenyiGraph(1500, 0.01, 8, -1, 50));
+  CSRGraph<int> reverse = transpose(CSRGraph<int> {G});
+  // a copy starts without an index, so each is built by threads workers
+  for (unsigned threads : {1u, 4u}) {
+    Graph<int> H {G};
+    for (int v = 0; v < H.size(); ++v) {
+      auto in = H.inNeighbours(v, threads);
+      ASSERT_EQ(static_cast<int>(in.size()),
+                reverse.offsets[v + 1] - reverse.offsets[v]);
+      for (std::size_t k = 0; k < in.size(); ++k) {
+        int e = reverse.offsets[v] + static_cast<int>(k);
+        ASSERT_EQ(in[k].first, reverse.targets[e]);
+        ASSERT_EQ(in[k].second, reverse.weights[e]);
+      }
+    }
+  }
+  EXPECT_THROW(G.inNeighbours(-1), std::out_of_range);
+  EXPECT_THROW(G.inNeighbours(G.size()), std::out_of_range);
+}
+
+TEST(inNeighboursTest, editsAndCopies) {
+  Graph<int> G {4};
+  G.addEdge(0, 2, 5);
+  G.addEdge(3, 2, 1);
+  using Edges = std::vector<std::pair<int, int> >;
+  auto inOf = [](const Graph<int>& g, int v) {
+    auto in = g.inNeighbours(v);
+    return Edges(in.begin(), in.end());
+  };
+  EXPECT_EQ(inOf(G, 2), (Edges {{0, 5}, {3, 1}}));
+  EXPECT_TRUE(G.inNeighbours(0).empty());
+  G.addEdge(1, 2, 7);
+  G.removeEdge(0, 2);
+  EXPECT_EQ(inOf(G, 2), (Edges {{1, 7}, {3, 1}}));
+  Graph<int> copy {G};
+  copy.addEdge(2, 0, 4);
+  EXPECT_EQ(inOf(copy, 0), (Edges {{2, 4}}));
+  EXPECT_TRUE(G.inNeighbours(0).empty());
+  G = copy;
+  EXPECT_EQ(inOf(G, 0), (Edges {{2, 4}}));
+  // concurrent readers share one build
+  Graph<int> big = toGraph(erdosRenyiGraph(800, 0.02, 9, 0, 9));
+  std::vector<std::size_t> counts(4);
+  std::vector<std::thread> readers {};
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&big, &counts, r]() {
+      for (int v = 0; v < big.size(); ++v) {
+        counts[r] += big.inNeighbours(v).size();
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  for (std::size_t count : counts) {
+    EXPECT_EQ(count, big.numEdges());
+  }
+}
+
+TEST(vertexIndexTest, narrowestType) {
+  auto indexSize = [](int N) {
+    return withVertexIndex(N, [](auto index) { return sizeof index; });
+  };
+  EXPECT_EQ(indexSize(0), sizeof(std::uint16_t));
+  EXPECT_EQ(indexSize(250), sizeof(std::uint16_t));
+  EXPECT_EQ(indexSize(65536), sizeof(std::uint16_t));
+  EXPECT_EQ(indexSize(65537), sizeof(std::uint32_t));
+}
+
+TEST(vertexIndexTest, narrowCSRMatchesInt) {
+  Graph<double> G {"mediumEWD.txt"};
+  CSRGraph<double> wide {G};
+  CSRGraph<double, std::uint16_t> narrow {G};
+  ASSERT_EQ(narrow.offsets, wide.offsets);
+  ASSERT_EQ(narrow.weights, wide.weights);
+  ASSERT_TRUE(std::equal(narrow.targets.begin(), narrow.targets.end(),
+                         wide.targets.begin(), wide.targets.end()));
+  auto wideReverse = transpose(wide);
+  auto narrowReverse = transpose(narrow);
+  EXPECT_EQ(narrowReverse.offsets, wideReverse.offsets);
+  EXPECT_TRUE(std::equal(narrowReverse.targets.begin(),
+                         narrowReverse.targets.end(),
+                         wideReverse.targets.begin(),
+                         wideReverse.targets.end()));
+  std::pmr::vector<double> wideDist {};
+  std::pmr::vector<double> narrowDist {};
+  for (int s : {0, 100, 249}) {
+    dijkstra(wide, s, wideDist, std::pmr::get_default_resource());
+    dijkstra(narrow, s, narrowDist, std::pmr::get_default_resource());
+    EXPECT_EQ(narrowDist, wideDist);
+  }
+  EXPECT_EQ(toGraph(narrow).numEdges(), G.numEdges());
+}
+
+TEST(numaTest, topology) {
+  EXPECT_EQ(parseCpuList("0-3,8,10-11"),
+            (std::vector<int> {0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(parseCpuList("5\n"), (std::vector<int> {5}));
+  EXPECT_TRUE(parseCpuList("").empty());
+  const NumaTopology& topology = numaTopology();
+  ASSERT_GE(topology.nodes(), 1);
+  for (unsigned id = 0; id < 8; ++id) {
+    int node = topology.nodeOfWorker(id, 8);
+    EXPECT_GE(node, 0);
+    EXPECT_LT(node, topology.nodes());
+  }
+  NumaPin pin {topology.nodes() - 1};
+  if (topology.nodes() == 1) {
+    EXPECT_FALSE(pin.active());
+  }
+  NumaPin disabled {0, false};
+  EXPECT_FALSE(disabled.active());
+}
+
+TEST(numaTest, placementKeepsResults) {
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  Graph<int> G = toGraph(erdosRenyiGraph(300, 0.02, 12, -1, 40, noLoops));
+  APSPOptions options;
+  options.numThreads = 4;
+  options.numaAware = true;
+  auto johnson = johnsonAPSP(G);
+  ASSERT_FALSE(johnson.empty());
+  EXPECT_EQ(johnsonAPSPWithOptions(G, options), johnson);
+  EXPECT_EQ(floydWarshallAPSPWithOptions(G, options), johnson);
+}
+
+TEST(hugePageTest, largeAllocations) {
+  HugePageResource resource {1 << 20};
+  {
+    DistanceMatrix<int> small {100, 0, &resource};
+    EXPECT_EQ(resource.report().largeAllocations, 0u);
+    DistanceMatrix<int> large {1024, 7, &resource};
+    HugePageReport report = resource.report();
+    EXPECT_EQ(report.largeAllocations, 1u);
+    EXPECT_EQ(report.advised + report.fallbacks, 1u);
+    if (report.advised == 1) {
+      EXPECT_EQ(report.advisedBytes, 2 * kHugePageSize);
+    }
+    EXPECT_EQ(large(1023, 1023), 7);
+    large(512, 3) = -1;
+    DistanceMatrix<int> copy = large;
+    EXPECT_EQ(copy, large);
+  }
+  std::string mode = transparentHugePageMode();
+  EXPECT_TRUE(mode == "always" or mode == "madvise" or mode == "never" or
+              mode == "unavailable");
+}
+
+TEST(hugePageTest, enginesUseIt) {
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  Graph<int> G = toGraph(erdosRenyiGraph(600, 0.01, 21, -1, 30, noLoops));
+  auto expected = johnsonAPSP(G);
+  ASSERT_FALSE(expected.empty());
+  HugePageResource resource {256 << 10};
+  APSPOptions options;
+  options.resource = &resource;
+  options.numThreads = 3;
+  EXPECT_EQ(minPlusSquaringAPSPWithOptions(G, options), expected);
+  EXPECT_EQ(johnsonAPSPWithOptions(G, options), expected);
+  EXPECT_GE(resource.report().largeAllocations, 2u);
+  // the Floyd-Warshall working matrix is one 600 x 600 allocation
+  std::uint64_t before = resource.report().largeAllocations;
+  EXPECT_EQ(floydWarshallAPSPWithOptions(G, options), expected);
+  EXPECT_EQ(resource.report().largeAllocations, before + 1);
+}
+
+TEST(hugePageTest, reportsActualBacking) {
+  HugePageResource resource {1 << 20};
+  EXPECT_EQ(resource.hugePageBytes(), 0u);
+  DistanceMatrix<int> large {2048, 1, &resource};
+  HugePageReport report = resource.report();
+  std::uint64_t backed = resource.hugePageBytes();
+  EXPECT_LE(backed, report.advisedBytes);
+  if (transparentHugePageMode() == "never") {
+    EXPECT_EQ(backed, 0u);
+  }
+}
+
+TEST(batchTest, matchesJohnsonPerGraph) {
+  std::vector<Graph<int> > graphs {};
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  for (int g = 0; g < 300; ++g) {
+    int V = 1 + g % 40;
+    graphs.push_back(
+        toGraph(erdosRenyiGraph(V, 0.2, g, g % 3 == 0 ? -3 : 0, 20, noLoops)));
+  }
+  graphs.push_back(Graph<int> {0});
+  APSPOptions options;
+  options.numThreads = 3;
+  auto results = batchAPSP(graphs, options);
+  ASSERT_EQ(results.size(), graphs.size());
+  int negative = 0;
+  for (std::size_t g = 0; g < graphs.size(); ++g) {
+    ASSERT_EQ(results[g], johnsonAPSP(graphs[g])) << "graph " << g;
+    negative += graphs[g].size() > 0 and results[g].empty();
+  }
+  // both paths see some negative cycles
+  EXPECT_GT(negative, 0);
+}
+
+TEST(batchTest, smallFloydWarshall) {
+  Graph<double> tiny {"tinyEWD.txt"};
+  ASSERT_LE(tiny.size(), kSmallGraphVertices);
+  auto expected = johnsonAPSP(tiny);
+  auto result = smallFloydWarshall<kSmallGraphVertices>(tiny);
+  ASSERT_EQ(result.size(), expected.size());
+  for (int i = 0; i < tiny.size(); ++i) {
+    for (int j = 0; j < tiny.size(); ++j) {
+      EXPECT_NEAR(result[i][j], expected[i][j], 1e-9);
+    }
+  }
+  Graph<int> cycle {3};
+  cycle.addEdge(0, 1, 2);
+  cycle.addEdge(1, 2, -4);
+  cycle.addEdge(2, 0, 1);
+  EXPECT_TRUE(smallFloydWarshall<4>(cycle).empty());
+  EXPECT_THROW(smallFloydWarshall<2>(cycle), std::invalid_argument);
+  std::vector<Graph<int> > one {cycle};
+  EXPECT_TRUE(batchAPSP<int>(one)[0].empty());
+  // every edge strongly negative: pivoting past the first negative
+  // diagonal entry would double the entries each round and overflow int
+  Graph<int> negative {60};
+  for (int i = 0; i < 60; ++i) {
+    for (int j = 0; j < 60; ++j) {
+      if (i != j) {
+        negative.addEdge(i, j, -1'000'000);
+      }
+    }
+  }
+  EXPECT_TRUE(smallFloydWarshall<kMediumGraphVertices>(negative).empty());
+  std::vector<Graph<int> > many {negative};
+  EXPECT_TRUE(batchAPSP<int>(many)[0].empty());
+}
+
+TEST(fixedTest, constantEvaluation) {
+  constexpr auto D = fixedFloydWarshallAPSP(fixedAdjacencyMatrix<int, 4>(
+      std::array {FixedEdge<int> {0, 1, 4}, FixedEdge<int> {1, 2, -1},
+                  FixedEdge<int> {0, 2, 5}, FixedEdge<int> {2, 0, 2}}));
+  static_assert(D.has_value());
+  static_assert((*D)[0][2] == 3);
+  static_assert((*D)[2][1] == 6);
+  static_assert((*D)[3][0] == infinity<int>());
+  constexpr auto cycle = fixedFloydWarshallAPSP(fixedAdjacencyMatrix<int, 2>(
+      std::array {FixedEdge<int> {0, 1, 1}, FixedEdge<int> {1, 0, -2}}));
+  static_assert(!cycle.has_value());
+  // every edge strongly negative: without stopping at the first negative
+  // diagonal entry the entries double each round and int overflows,
+  // which would not compile
+  constexpr auto negative = fixedFloydWarshallAPSP([] {
+    std::array<FixedEdge<int>, 32 * 31> edges {};
+    std::size_t e = 0;
+    for (std::size_t i = 0; i < 32; ++i) {
+      for (std::size_t j = 0; j < 32; ++j) {
+        if (i != j) {
+          edges[e++] = {i, j, -1'000'000};
+        }
+      }
+    }
+    return fixedAdjacencyMatrix<int, 32>(edges);
+  }());
+  static_assert(!negative.has_value());
+  EXPECT_THROW((fixedAdjacencyMatrix<int, 2>(
+                   std::array {FixedEdge<int> {0, 2, 1}})),
+               std::out_of_range);
+}
+
+TEST(fixedTest, matchesJohnson) {
+  Graph<double> tiny {"tinyEWD.txt"};
+  auto expected = johnsonAPSP(tiny);
+  auto D = fixedFloydWarshallAPSP(fixedAdjacencyMatrix<double, 8>(tiny));
+  ASSERT_TRUE(D.has_value());
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      EXPECT_NEAR((*D)[i][j], expected[i][j], 1e-9);
+    }
+  }
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  Graph<int> G = toGraph(erdosRenyiGraph(64, 0.05, 17, -2, 30, noLoops));
+  auto rows = johnsonAPSP(G);
+  auto fixed = fixedFloydWarshallAPSP(fixedAdjacencyMatrix<int, 64>(G));
+  ASSERT_EQ(fixed.has_value(), !rows.empty());
+  for (int i = 0; fixed and i < 64; ++i) {
+    EXPECT_TRUE(std::equal(rows[i].begin(), rows[i].end(),
+                           (*fixed)[i].begin()));
+  }
+  EXPECT_THROW((fixedAdjacencyMatrix<double, 7>(tiny)),
+               std::invalid_argument);
+}
+
+// writes G in the edge list format to a fresh file and returns its path
+template <typename T>
+std::string writeEdgeList(const Graph<T>& G, const std::string& name) {
+  std::string path = checkpointPath(name);
+  std::ofstream out {path};
+  out << G.size() << '\n';
+  for (int u = 0; u < G.size(); ++u) {
+    for (const auto& [v, weight] : G.neighbours(u)) {
+      out << u << ' ' << v << ' ' << weight << '\n';
+    }
+  }
+  return path;
+}
+
+template <typename T>
+void expectSameCSR(const CSRGraph<T>& a, const CSRGraph<T>& b) {
+  EXPECT_EQ(a.offsets, b.offsets);
+  EXPECT_EQ(a.targets, b.targets);
+  EXPECT_EQ(a.weights, b.weights);
+}
+
+TEST(loaderTest, matchesGraphConstructor) {
+  for (std::string file : {"tinyEWD.txt", "mediumEWD.txt"}) {
+    expectSameCSR(loadEdgeList<double>(file),
+                  CSRGraph<double> {Graph<double> {file}});
+    expectSameCSR(loadEdgeList<int>(file), CSRGraph<int> {Graph<int> {file}});
+  }
+  Graph<int> G = toGraph(erdosRenyiGraph(3000, 0.01, 3, -5, 1000));
+  std::string path = writeEdgeList(G, "loader_large.txt");
+  LoadOptions options;
+  options.numThreads = 4;
+  expectSameCSR(loadEdgeList<int>(path, options), CSRGraph<int> {G});
+  EXPECT_EQ(loadGraph<int>(path, options).numEdges(), G.numEdges());
+  std::filesystem::remove(path);
+}
+
+TEST(loaderTest, duplicatesAndErrors) {
+  std::string path = checkpointPath("loader_edges.txt");
+  auto write = [&path](const std::string& text) {
+    std::ofstream {path} << text;
+  };
+  write("3\n0 1 5\r\n2 0 1\n0 1 7\n\n  1 2 -3\n");
+  CSRGraph<int> csr = loadEdgeList<int>(path);
+  EXPECT_EQ(csr.offsets, (std::pmr::vector<int> {0, 1, 2, 3}));
+  EXPECT_EQ(csr.targets, (std::pmr::vector<int> {1, 2, 0}));
+  // the first edge from 0 to 1 wins, as with Graph::addEdge
+  EXPECT_EQ(csr.weights, (std::pmr::vector<int> {5, -3, 1}));
+  write("3\n0 3 1\n");
+  EXPECT_THROW(loadEdgeList<int>(path), std::out_of_range);
+  write("3\n0 1 x\n");
+  EXPECT_THROW(loadEdgeList<int>(path), std::invalid_argument);
+  write("3\n0 1\n");
+  EXPECT_THROW(loadEdgeList<int>(path), std::invalid_argument);
+  write("\x1f\x8b not really gzip");
+#ifndef GRAPH_ENABLE_ZLIB
+  EXPECT_THROW(loadEdgeList<int>(path), std::runtime_error);
+#endif
+  std::filesystem::remove(path);
+  EXPECT_THROW(loadEdgeList<int>(path), std::runtime_error);
+}
+
+#ifdef GRAPH_ENABLE_ZLIB
+TEST(loaderTest, gzipInput) {
+  std::ifstream in {"mediumEWD.txt", std::ios::binary};
+  std::string text {std::istreambuf_iterator<char> {in}, {}};
+  std::string path = checkpointPath("loader_medium.txt.gz");
+  gzFile file = gzopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  gzwrite(file, text.data(), static_cast<unsigned>(text.size()));
+  gzclose(file);
+  LoadOptions options;
+  options.blockBytes = 1000;
+  expectSameCSR(loadEdgeList<double>(path, options),
+                CSRGraph<double> {Graph<double> {"mediumEWD.txt"}});
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 20);
+  EXPECT_THROW(loadEdgeList<double>(path), std::runtime_error);
+  std::filesystem::remove(path);
+}
+#endif
+
+#ifdef GRAPH_ENABLE_ZSTD
+TEST(loaderTest, zstdInput) {
+  std::ifstream in {"mediumEWD.txt", std::ios::binary};
+  std::string text {std::istreambuf_iterator<char> {in}, {}};
+  std::string packed(ZSTD_compressBound(text.size()), '\0');
+  std::size_t size = ZSTD_compress(packed.data(), packed.size(), text.data(),
+                                   text.size(), 3);
+  ASSERT_FALSE(ZSTD_isError(size));
+  std::string path = checkpointPath("loader_medium.txt.zst");
+  std::ofstream {path, std::ios::binary}.write(packed.data(), size);
+  LoadOptions options;
+  options.blockBytes = 1000;
+  expectSameCSR(loadEdgeList<double>(path, options),
+                CSRGraph<double> {Graph<double> {"mediumEWD.txt"}});
+  // a truncated frame is an error, not a shorter edge list
+  std::filesystem::resize_file(path, size - 20);
+  EXPECT_THROW(loadEdgeList<double>(path), std::runtime_error);
+  std::filesystem::remove(path);
+}
+#endif
+
+TEST(loaderTest, smallBlocks) {
+  CSRGraph<double> expected {Graph<double> {"mediumEWD.txt"}};
+  LoadOptions options;
+  options.numThreads = 3;
+  // shorter than some lines, so the block has to grow
+  for (std::size_t bytes : {7, 100, 4096}) {
+    options.blockBytes = bytes;
+    expectSameCSR(loadEdgeList<double>("mediumEWD.txt", options), expected);
+  }
+  options.blockBytes = 0;
+  EXPECT_THROW(loadEdgeList<double>("mediumEWD.txt", options),
+               std::invalid_argument);
+}
+
+TEST(loaderTest, nativeAndFixedPointWeights) {
+  std::string path = checkpointPath("loader_weights.txt");
+  auto write = [&path](const std::string& text) {
+    std::ofstream {path} << text;
+  };
+  write("3\n0 1 0.26\n1 2 -1.5\n0 2 3\n2 0 0.120\n");
+  CSRGraph<double> real = loadEdgeList<double>(path);
+  EXPECT_EQ(real.weights, (std::pmr::vector<double> {0.26, 3, -1.5, 0.12}));
+  // no silent truncation of fractional weights to integers
+  EXPECT_THROW(loadEdgeList<int>(path), std::invalid_argument);
+  LoadOptions scaled;
+  scaled.fixedPointDigits = 2;
+  CSRGraph<std::int64_t> cents = loadEdgeList<std::int64_t>(path, scaled);
+  EXPECT_EQ(cents.weights,
+            (std::pmr::vector<std::int64_t> {26, 300, -150, 12}));
+  scaled.fixedPointDigits = 1;
+  EXPECT_THROW(loadEdgeList<std::int64_t>(path, scaled),
+               std::invalid_argument);
+  EXPECT_THROW(loadEdgeList<double>(path, scaled), std::invalid_argument);
+
+  std::int16_t small {};
+  std::string text = "-3276.8 3276.8 1e3 - .5";
+  const char* p = text.data();
+  const char* stop = p + text.size();
+  p = parseFixedPoint(p, stop, 1, small);
+  EXPECT_EQ(small, -32768);
+  EXPECT_EQ(parseFixedPoint(p + 1, stop, 1, small), nullptr);
+  EXPECT_EQ(*parseFixedPoint(p + 8, stop, 1, small), 'e');
+  EXPECT_EQ(parseFixedPoint(p + 12, stop, 1, small), nullptr);
+  EXPECT_NE(parseFixedPoint(p + 14, stop, 1, small), nullptr);
+  EXPECT_EQ(small, 5);
+  unsigned positive {};
+  text = "-1";
+  EXPECT_EQ(parseFixedPoint(text.data(), text.data() + 2, 0, positive),
+            nullptr);
+  std::filesystem::remove(path);
+}
+
+TEST(loaderTest, fixedPointSolversAgreeExactly) {
+  LoadOptions scaled;
+  scaled.fixedPointDigits = 3;
+  Graph<std::int64_t> G = loadGraph<std::int64_t>("mediumEWD.txt", scaled);
+  std::vector<std::vector<std::int64_t> > johnson = johnsonAPSP(G);
+  EXPECT_EQ(johnson, floydWarshallAPSP(G));
+  EXPECT_EQ(johnson[0][1], 71178000);
+}
+
+// *** Finished-row reuse tests
+
+TEST(reuseRowsTest, depthFirstPostOrder) {
+  Graph<int> G {4};
+  G.addEdge(0, 1, 1);
+  G.addEdge(1, 2, 1);
+  G.addEdge(0, 3, 1);
+  G.addEdge(2, 0, 1);
+  CSRGraph<int> csr {G};
+  EXPECT_EQ(depthFirstPostOrder(csr, std::pmr::get_default_resource()),
+            (std::pmr::vector<int> {2, 1, 3, 0}));
+}
+
+TEST(reuseRowsTest, matchesPlainJohnson) {
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  for (std::uint64_t seed : {1, 2, 3}) {
+    Graph<int> G = toGraph(erdosRenyiGraph(300, 0.03, seed, -1, 100,
+                                           noLoops));
+    std::vector<std::vector<int> > expected = johnsonAPSP(G);
+    ASSERT_FALSE(expected.empty());
+    APSPOptions options {};
+    options.reuseFinishedRows = true;
+    for (unsigned threads : {1u, 4u}) {
+      options.numThreads = threads;
+      EXPECT_EQ(johnsonAPSPWithOptions(G, options), expected);
+    }
+  }
+  Graph<double> road {"mediumEWD.txt"};
+  APSPOptions options {};
+  options.reuseFinishedRows = true;
+  EXPECT_EQ(johnsonAPSPWithOptions(road, options), johnsonAPSP(road));
+}
+
+TEST(reuseRowsTest, skipsScans) {
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  Graph<int> G = toGraph(erdosRenyiGraph(400, 0.05, 9, 1, 100, noLoops));
+  APSPStats plain {};
+  APSPStats reused {};
+  APSPOptions options {};
+  options.numThreads = 1;
+  options.stats = &plain;
+  std::vector<std::vector<int> > expected = johnsonAPSPWithOptions(G, options);
+  options.stats = &reused;
+  options.reuseFinishedRows = true;
+  EXPECT_EQ(johnsonAPSPWithOptions(G, options), expected);
+  if constexpr (kStatsEnabled) {
+    EXPECT_GT(reused.boundedVertices, 0u);
+    EXPECT_LT(reused.edgeRelaxations, plain.edgeRelaxations);
+    EXPECT_LT(reused.heapPops, plain.heapPops);
+  }
+  options.sourceBatch = 8;
+  EXPECT_THROW(johnsonAPSPWithOptions(G, options), std::invalid_argument);
+}
+
+// *** Fingerprint and result cache tests
+
+TEST(fingerprintTest, dependsOnContentOnly) {
+  Graph<int> A {4};
+  Graph<int> B {4};
+  A.addEdge(0, 1, 5);
+  A.addEdge(2, 3, -1);
+  A.addEdge(1, 2, 7);
+  B.addEdge(1, 2, 7);
+  B.addEdge(2, 3, -1);
+  B.addEdge(0, 1, 5);
+  EXPECT_EQ(A.fingerprint(), B.fingerprint());
+  GraphFingerprint before = A.fingerprint();
+  // an existing edge keeps its weight, as does the fingerprint
+  A.addEdge(0, 1, 9);
+  EXPECT_EQ(A.fingerprint(), before);
+  A.addEdge(3, 0, 2);
+  EXPECT_NE(A.fingerprint(), before);
+  A.removeEdge(3, 0);
+  A.removeEdge(3, 1);
+  EXPECT_EQ(A.fingerprint(), before);
+  B.removeEdge(1, 2);
+  B.addEdge(1, 2, 8);
+  EXPECT_NE(B.fingerprint(), before);
+  EXPECT_NE(Graph<int> {4}.fingerprint(), Graph<int> {5}.fingerprint());
+  Graph<int> copy = A;
+  EXPECT_EQ(copy.fingerprint(), before);
+  EXPECT_EQ(loadGraph<double>("mediumEWD.txt").fingerprint(),
+            Graph<double> {"mediumEWD.txt"}.fingerprint());
+}
+
+TEST(cacheTest, memoryHitsAndEviction) {
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  std::vector<Graph<int> > graphs {};
+  for (std::uint64_t seed : {1, 2, 3}) {
+    graphs.push_back(toGraph(erdosRenyiGraph(100, 0.05, seed, 1, 50,
+                                             noLoops)));
+  }
+  // room for two 100 x 100 results but not three
+  APSPCache<int> cache {2 * 100 * 100 * sizeof(int) + 8192};
+  int solves = 0;
+  auto solve = [&solves](const Graph<int>& G) {
+    ++solves;
+    return johnsonAPSP(G);
+  };
+  auto first = cache.get(graphs[0], solve);
+  EXPECT_EQ(*first, johnsonAPSP(graphs[0]));
+  EXPECT_TRUE(cache.get(graphs[0], solve) == first);
+  cache.get(graphs[1], solve);
+  cache.get(graphs[0], solve);
+  // graphs[1] is now the least recently used
+  cache.get(graphs[2], solve);
+  EXPECT_EQ(solves, 3);
+  EXPECT_TRUE(cache.find(graphs[0]) != nullptr);
+  EXPECT_TRUE(cache.find(graphs[1]) == nullptr);
+  APSPCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.misses, 3u);
+  EXPECT_EQ(stats.hits, 3u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_LE(cache.bytesUsed(), 2 * 100 * 100 * sizeof(int) + 8192);
+
+  // an edit misses, undoing it hits again
+  auto [v, weight] = *graphs[0].neighbours(0).begin();
+  graphs[0].removeEdge(0, v);
+  EXPECT_TRUE(cache.find(graphs[0]) == nullptr);
+  graphs[0].addEdge(0, v, weight);
+  EXPECT_TRUE(cache.find(graphs[0]) == first);
+}
+
+TEST(cacheTest, diskBacked) {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "apsp_cache_test";
+  std::filesystem::remove_all(directory);
+  Graph<double> road {"mediumEWD.txt"};
+  Graph<int> cycle {2};
+  cycle.addEdge(0, 1, 1);
+  cycle.addEdge(1, 0, -2);
+  {
+    APSPCache<double> cache {1 << 20, directory.string()};
+    EXPECT_EQ(*cache.get(road), johnsonAPSP(road));
+    APSPCache<int> ints {1 << 20, directory.string()};
+    EXPECT_TRUE(ints.get(cycle)->empty());
+  }
+  // a fresh cache, as in another process, finds both on disk
+  APSPCache<double> cache {1 << 20, directory.string()};
+  auto solveless = [](const Graph<double>&) {
+    throw std::logic_error("should have been cached");
+    return std::vector<std::vector<double> > {};
+  };
+  EXPECT_EQ(*cache.get(road, solveless), johnsonAPSP(road));
+  EXPECT_EQ(cache.stats().diskHits, 1u);
+  cache.clear();
+  EXPECT_NE(cache.find(road), nullptr);
+  APSPCache<int> ints {1 << 20, directory.string()};
+  EXPECT_TRUE(ints.find(cycle)->empty());
+  // a result for another weight type is not mistaken for this one
+  APSPCache<int> other {1 << 20, directory.string()};
+  Graph<int> roadInts = loadGraph<int>("mediumEWD.txt");
+  EXPECT_EQ(other.find(roadInts), nullptr);
+  // a damaged file is ignored
+  for (const auto& file : std::filesystem::directory_iterator {directory}) {
+    std::filesystem::resize_file(file.path(), 100);
+  }
+  APSPCache<double> damaged {1 << 20, directory.string()};
+  EXPECT_EQ(damaged.find(road), nullptr);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(cacheTest, concurrentMissesOnOneGraph) {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "apsp_cache_race";
+  std::filesystem::remove_all(directory);
+  GeneratorOptions noLoops;
+  noLoops.selfLoops = false;
+  Graph<int> G = toGraph(erdosRenyiGraph(200, 0.03, 4, 1, 50, noLoops));
+  std::vector<std::vector<int> > expected = johnsonAPSP(G);
+  APSPCache<int> cache {1 << 20, directory.string()};
+  // every thread misses before any stores, so all of them write the file
+  std::barrier solved {8};
+  std::vector<std::shared_ptr<const std::vector<std::vector<int> > > >
+      results(8);
+  std::vector<std::thread> threads {};
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      results[t] = cache.get(G, [&](const Graph<int>& graph) {
+        auto rows = johnsonAPSP(graph);
+        solved.arrive_and_wait();
+        return rows;
+      });
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const auto& result : results) {
+    EXPECT_TRUE(*result == expected);
+  }
+  EXPECT_EQ(cache.stats().diskWriteFailures, 0u);
+  int files = 0;
+  for (const auto& file : std::filesystem::directory_iterator {directory}) {
+    EXPECT_EQ(file.path().extension(), ".apsp");
+    ++files;
+  }
+  EXPECT_EQ(files, 1);
+  APSPCache<int> fresh {1 << 20, directory.string()};
+  ASSERT_TRUE(fresh.find(G) != nullptr);
+  EXPECT_TRUE(*fresh.find(G) == expected);
+
+  // a directory that has gone away costs the disk copy, not the result
+  std::filesystem::remove_all(directory);
+  ASSERT_FALSE(G.neighbours(0).empty());
+  G.removeEdge(0, G.neighbours(0).begin()->first);
+  EXPECT_TRUE(*cache.get(G) == johnsonAPSP(G));
+  EXPECT_EQ(cache.stats().diskWriteFailures, 1u);
+}
+
 int main(int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
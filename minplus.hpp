@@ -0,0 +1,301 @@
+#ifndef MINPLUS_HPP_
+#define MINPLUS_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "graph.hpp"
+
+// Min-plus (tropical) matrix product
+// C(i, j) = min over k of A(i, k) + B(k, j), with infinity<T>() absorbing.
+// The kernel is laid out like a GEMM: the k and j ranges are cut into
+// tiles that keep a strip of B in L1, and within a tile a 4-row by
+// two-vector block of C stays in registers while k runs. int, float and
+// double get AVX2 microkernels on x86 CPUs that have AVX2; every other
+// case, and the ragged edges of each tile, use the scalar loop.
+
+// k and j extents of one tile, in elements
+inline constexpr int kMinPlusTileK = 128;
+inline constexpr int kMinPlusTileJ = 512;
+// rows of C held in registers by a microkernel
+inline constexpr int kMinPlusRows = 4;
+
+// lane operations for the microkernel; Lanes == 0 means no SIMD path
+template <typename T>
+struct MinPlusLanes {
+  static constexpr int Lanes = 0;
+};
+
+#ifdef GRAPH_AVX2
+template <>
+struct MinPlusLanes<int> {
+  static constexpr int Lanes = 8;
+  using Vec = __m256i;
+  GRAPH_AVX2_TARGET static Vec load(const int* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  GRAPH_AVX2_TARGET static void store(int* p, Vec v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  GRAPH_AVX2_TARGET static Vec broadcast(int a) {
+    return _mm256_set1_epi32(a);
+  }
+  // lanes of b that are infinity, where a + b would wrap around
+  GRAPH_AVX2_TARGET static Vec infinityMask(Vec b) {
+    return _mm256_cmpeq_epi32(b, broadcast(infinity<int>()));
+  }
+  GRAPH_AVX2_TARGET static Vec rowMask(bool isInfinity) {
+    return _mm256_set1_epi32(isInfinity ? -1 : 0);
+  }
+  GRAPH_AVX2_TARGET static Vec relax(Vec c, Vec a, Vec b, Vec mask) {
+    Vec sum = _mm256_add_epi32(a, b);
+    sum = _mm256_blendv_epi8(sum, broadcast(infinity<int>()), mask);
+    return _mm256_min_epi32(c, sum);
+  }
+};
+
+// IEEE infinity already absorbs, so the masks are never needed
+template <>
+struct MinPlusLanes<float> {
+  static constexpr int Lanes = 8;
+  using Vec = __m256;
+  GRAPH_AVX2_TARGET static Vec load(const float* p) {
+    return _mm256_loadu_ps(p);
+  }
+  GRAPH_AVX2_TARGET static void store(float* p, Vec v) {
+    _mm256_storeu_ps(p, v);
+  }
+  GRAPH_AVX2_TARGET static Vec broadcast(float a) {
+    return _mm256_set1_ps(a);
+  }
+  GRAPH_AVX2_TARGET static Vec infinityMask(Vec) {
+    return _mm256_setzero_ps();
+  }
+  GRAPH_AVX2_TARGET static Vec rowMask(bool) {
+    return _mm256_setzero_ps();
+  }
+  GRAPH_AVX2_TARGET static Vec relax(Vec c, Vec a, Vec b, Vec) {
+    return _mm256_min_ps(c, _mm256_add_ps(a, b));
+  }
+};
+
+template <>
+struct MinPlusLanes<double> {
+  static constexpr int Lanes = 4;
+  using Vec = __m256d;
+  GRAPH_AVX2_TARGET static Vec load(const double* p) {
+    return _mm256_loadu_pd(p);
+  }
+  GRAPH_AVX2_TARGET static void store(double* p, Vec v) {
+    _mm256_storeu_pd(p, v);
+  }
+  GRAPH_AVX2_TARGET static Vec broadcast(double a) {
+    return _mm256_set1_pd(a);
+  }
+  GRAPH_AVX2_TARGET static Vec infinityMask(Vec) {
+    return _mm256_setzero_pd();
+  }
+  GRAPH_AVX2_TARGET static Vec rowMask(bool) {
+    return _mm256_setzero_pd();
+  }
+  GRAPH_AVX2_TARGET static Vec relax(Vec c, Vec a, Vec b, Vec) {
+    return _mm256_min_pd(c, _mm256_add_pd(a, b));
+  }
+};
+#endif
+
+// C = min(C, A * B) over rows [i0, i1), columns [j0, j1) and k in [k0, k1)
+template <typename T>
+void minPlusScalarBlock(const DistanceMatrix<T>& A, const DistanceMatrix<T>& B,
+                        DistanceMatrix<T>& C, int i0, int i1, int j0, int j1,
+                        int k0, int k1) {
+  const T inf = infinity<T>();
+  for (int i = i0; i < i1; ++i) {
+    T* c = C.row(i);
+    for (int k = k0; k < k1; ++k) {
+      T a = A(i, k);
+      if (a == inf) {
+        continue;
+      }
+      const T* b = B.row(k);
+      for (int j = j0; j < j1; ++j) {
+        if (b[j] != inf and a + b[j] < c[j]) {
+          c[j] = a + b[j];
+        }
+      }
+    }
+  }
+}
+
+#ifdef GRAPH_AVX2
+// one tile with the AVX2 microkernel over the full 4-row by two-vector
+// blocks and the scalar loop over what is left; T must have lanes
+template <typename T>
+GRAPH_AVX2_TARGET void minPlusVectorTile(const DistanceMatrix<T>& A,
+                                         const DistanceMatrix<T>& B,
+                                         DistanceMatrix<T>& C, int i0,
+                                         int i1, int j0, int j1, int k0,
+                                         int k1) {
+  using Lanes = MinPlusLanes<T>;
+  using Vec = typename Lanes::Vec;
+  constexpr int W = 2 * Lanes::Lanes;
+  const T inf = infinity<T>();
+  int jVector = j0 + (j1 - j0) / W * W;
+  int iVector = i0 + (i1 - i0) / kMinPlusRows * kMinPlusRows;
+  for (int i = i0; i < iVector; i += kMinPlusRows) {
+    for (int j = j0; j < jVector; j += W) {
+      Vec c[kMinPlusRows][2];
+      for (int r = 0; r < kMinPlusRows; ++r) {
+        c[r][0] = Lanes::load(C.row(i + r) + j);
+        c[r][1] = Lanes::load(C.row(i + r) + j + Lanes::Lanes);
+      }
+      for (int k = k0; k < k1; ++k) {
+        const T* b = B.row(k) + j;
+        Vec b0 = Lanes::load(b);
+        Vec b1 = Lanes::load(b + Lanes::Lanes);
+        Vec inf0 = Lanes::infinityMask(b0);
+        Vec inf1 = Lanes::infinityMask(b1);
+        for (int r = 0; r < kMinPlusRows; ++r) {
+          T a = A(i + r, k);
+          Vec av = Lanes::broadcast(a);
+          Vec aInf = Lanes::rowMask(a == inf);
+          if constexpr (std::is_integral_v<T>) {
+            c[r][0] = Lanes::relax(c[r][0], av, b0,
+                                   _mm256_or_si256(inf0, aInf));
+            c[r][1] = Lanes::relax(c[r][1], av, b1,
+                                   _mm256_or_si256(inf1, aInf));
+          } else {
+            c[r][0] = Lanes::relax(c[r][0], av, b0, aInf);
+            c[r][1] = Lanes::relax(c[r][1], av, b1, aInf);
+          }
+        }
+      }
+      for (int r = 0; r < kMinPlusRows; ++r) {
+        Lanes::store(C.row(i + r) + j, c[r][0]);
+        Lanes::store(C.row(i + r) + j + Lanes::Lanes, c[r][1]);
+      }
+    }
+    minPlusScalarBlock(A, B, C, i, i + kMinPlusRows, jVector, j1, k0, k1);
+  }
+  minPlusScalarBlock(A, B, C, iVector, i1, j0, j1, k0, k1);
+}
+#endif
+
+// one tile, with the microkernel if T has lanes and vector is set
+template <typename T>
+void minPlusTile(const DistanceMatrix<T>& A, const DistanceMatrix<T>& B,
+                 DistanceMatrix<T>& C, int i0, int i1, int j0, int j1,
+                 int k0, int k1, bool vector) {
+#ifdef GRAPH_AVX2
+  if constexpr (MinPlusLanes<T>::Lanes != 0) {
+    if (vector) {
+      minPlusVectorTile(A, B, C, i0, i1, j0, j1, k0, k1);
+      return;
+    }
+  }
+#endif
+  (void)vector;
+  minPlusScalarBlock(A, B, C, i0, i1, j0, j1, k0, k1);
+}
+
+// C = min(C, A * B), splitting rows of C across numThreads workers
+// (0 means std::thread::hardware_concurrency()); C must not alias A or B
+template <typename T>
+void minPlusMultiplyInto(const DistanceMatrix<T>& A,
+                         const DistanceMatrix<T>& B, DistanceMatrix<T>& C,
+                         unsigned numThreads = 0) {
+  const int V = A.size();
+  if (B.size() != V or C.size() != V) {
+    throw std::invalid_argument("min-plus operands must be the same size");
+  }
+  // rows are handed out in groups that are a whole number of microkernel
+  // blocks so that only the last group has a ragged edge
+  const int rowsPerTask = kMinPlusRows * 8;
+  const int tasks = (V + rowsPerTask - 1) / rowsPerTask;
+  std::atomic<int> nextTask {0};
+  const bool vector = cpuHasAVX2();
+  runWorkers(workerCount(numThreads, V), [&](unsigned) {
+    for (int task = nextTask++; task < tasks; task = nextTask++) {
+      int i0 = task * rowsPerTask;
+      int i1 = std::min(V, i0 + rowsPerTask);
+      for (int j0 = 0; j0 < V; j0 += kMinPlusTileJ) {
+        int j1 = std::min(V, j0 + kMinPlusTileJ);
+        for (int k0 = 0; k0 < V; k0 += kMinPlusTileK) {
+          int k1 = std::min(V, k0 + kMinPlusTileK);
+          minPlusTile(A, B, C, i0, i1, j0, j1, k0, k1, vector);
+        }
+      }
+    }
+  });
+}
+
+// min-plus product of A and B
+template <typename T>
+DistanceMatrix<T> minPlusMultiply(const DistanceMatrix<T>& A,
+                                  const DistanceMatrix<T>& B,
+                                  unsigned numThreads = 0) {
+  DistanceMatrix<T> C {A.size()};
+  minPlusMultiplyInto(A, B, C, numThreads);
+  return C;
+}
+
+// APSP by repeated squaring of the adjacency matrix
+// D^(2m) = D^m * D^m covers paths of up to 2m edges; squaring stops as
+// soon as a product leaves the matrix unchanged, or after ceil(log2(V))
+// squarings. Returns an empty matrix if G has a negative weight cycle
+template <typename T>
+std::vector<std::vector<T> >
+minPlusSquaringAPSPWithOptions(const Graph<T>& G, const APSPOptions& options) {
+  const int V = G.size();
+  APSPStats local {};
+  PhaseTimer load {&local.loadTime};
+  DistanceMatrix<T> D = adjacencyMatrix(G, options.resource);
+  load.stop();
+  auto negativeDiagonal = [V](const DistanceMatrix<T>& M) {
+    for (int i = 0; i < V; ++i) {
+      if (M(i, i) < T {}) {
+        return true;
+      }
+    }
+    return false;
+  };
+  if (negativeDiagonal(D)) {
+    publishStats(options, local);
+    return {};
+  }
+  // the last product covers walks of at least V edges, so every simple
+  // cycle has been seen on the diagonal by the time the loop ends
+  DistanceMatrix<T> next {V, infinity<T>(), options.resource};
+  for (int hops = 1; hops < V; hops *= 2) {
+    // starting from D keeps every path already found, so the product is
+    // monotone and equality means nothing improved
+    next = D;
+    minPlusMultiplyInto(D, D, next, options.numThreads);
+    if constexpr (kStatsEnabled) {
+      local.edgeRelaxations += static_cast<std::uint64_t>(V) * V * V;
+    }
+    if (negativeDiagonal(next)) {
+      publishStats(options, local);
+      return {};
+    }
+    bool unchanged = next == D;
+    std::swap(D, next);
+    if (unchanged) {
+      break;
+    }
+  }
+  publishStats(options, local);
+  return D.toRows();
+}
+
+// APSP by repeated min-plus squaring
+// returns an empty matrix if G has a negative weight cycle
+template <typename T>
+std::vector<std::vector<T> >
+minPlusSquaringAPSP(const Graph<T>& G) {
+  return minPlusSquaringAPSPWithOptions(G, APSPOptions {});
+}
+
+#endif      // MINPLUS_HPP_
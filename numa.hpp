@@ -0,0 +1,148 @@
+#ifndef NUMA_HPP_
+#define NUMA_HPP_
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// NUMA placement for the APSP workers
+// The topology is read once from Linux sysfs; anywhere else, or if sysfs
+// cannot be read, the machine is treated as a single node. Pinning uses
+// pthread affinity and is skipped on a single node, so callers need no
+// special case for ordinary machines. Memory placement relies on the
+// kernel's first-touch policy: a page lands on the node of the thread
+// that first writes it, so pinned workers that initialise their own rows
+// get local memory without libnuma.
+
+// CPUs in a sysfs cpulist such as "0-3,8,10-11"
+inline std::vector<int> parseCpuList(const std::string& list) {
+  std::vector<int> cpus {};
+  std::stringstream ranges {list};
+  std::string range {};
+  while (std::getline(ranges, range, ',')) {
+    std::size_t dash = range.find('-');
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos
+                     ? first
+                     : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::logic_error&) {
+      // blank or malformed entry
+    }
+  }
+  return cpus;
+}
+
+class NumaTopology {
+ private:
+  // CPUs of each node with any, in node order
+  std::vector<std::vector<int> > nodeCpus {};
+
+ public:
+  // reads /sys/devices/system/node; a single node if that fails
+  NumaTopology() {
+#ifdef __linux__
+    for (int node = 0;; ++node) {
+      std::ifstream in {"/sys/devices/system/node/node" +
+                        std::to_string(node) + "/cpulist"};
+      if (!in) {
+        break;
+      }
+      std::string list {};
+      std::getline(in, list);
+      std::vector<int> cpus = parseCpuList(list);
+      // memory-only nodes have no CPUs to run workers on
+      if (!cpus.empty()) {
+        nodeCpus.push_back(std::move(cpus));
+      }
+    }
+#endif
+    if (nodeCpus.empty()) {
+      nodeCpus.push_back({});
+    }
+  }
+
+  int nodes() const {
+    return static_cast<int>(nodeCpus.size());
+  }
+
+  const std::vector<int>& cpus(int node) const {
+    return nodeCpus.at(node);
+  }
+
+  // node of worker id out of workers, spreading them evenly over nodes
+  int nodeOfWorker(unsigned id, unsigned workers) const {
+    return static_cast<int>(static_cast<long long>(id) * nodes() /
+                            std::max(1u, workers));
+  }
+};
+
+inline const NumaTopology& numaTopology() {
+  static const NumaTopology topology {};
+  return topology;
+}
+
+// Pins the calling thread to the CPUs of a NUMA node for its lifetime and
+// restores the old affinity on destruction. Does nothing on a single node
+// or if enabled is false
+class NumaPin {
+ private:
+#ifdef __linux__
+  cpu_set_t saved {};
+#endif
+  bool pinned = false;
+
+ public:
+  NumaPin(int node, bool enabled = true) {
+#ifdef __linux__
+    const NumaTopology& topology = numaTopology();
+    if (!enabled or topology.nodes() < 2) {
+      return;
+    }
+    pthread_t self = pthread_self();
+    if (pthread_getaffinity_np(self, sizeof saved, &saved) != 0) {
+      return;
+    }
+    cpu_set_t mask {};
+    CPU_ZERO(&mask);
+    for (int cpu : topology.cpus(node)) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &mask);
+      }
+    }
+    pinned = pthread_setaffinity_np(self, sizeof mask, &mask) == 0;
+#else
+    (void)node;
+    (void)enabled;
+#endif
+  }
+
+  NumaPin(const NumaPin&) = delete;
+  NumaPin& operator=(const NumaPin&) = delete;
+
+  ~NumaPin() {
+#ifdef __linux__
+    if (pinned) {
+      pthread_setaffinity_np(pthread_self(), sizeof saved, &saved);
+    }
+#endif
+  }
+
+  // did the constructor change the thread's affinity?
+  bool active() const {
+    return pinned;
+  }
+};
+
+#endif      // NUMA_HPP_
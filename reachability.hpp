@@ -0,0 +1,268 @@
+#ifndef REACHABILITY_HPP_
+#define REACHABILITY_HPP_
+
+#include <algorithm>
+#include <barrier>
+#include <cstdint>
+#include <vector>
+#include "graph.hpp"
+
+// Transitive closure as a bit matrix
+// For consumers that only ask whether t is reachable from s, which is the
+// infinity<T>() test on an APSP entry. One bit per pair is 32 times
+// smaller than an int distance matrix and weights are never looked at,
+// so negative cycles do not matter.
+//
+// The closure is built on the condensation of G: vertices of one strongly
+// connected component reach the same set, and Tarjan's algorithm emits the
+// components successors first, so a component's row is the OR of the rows
+// of the components its edges lead into, 64 targets per word. Components
+// are grouped by their height in the condensation; those of equal height
+// do not depend on each other and are shared out between workers.
+
+class ReachabilityMatrix {
+ private:
+  std::vector<std::uint64_t> words {};
+  int numVertices {};
+  std::size_t wordsPerRow {};
+
+ public:
+  ReachabilityMatrix() = default;
+
+  // N x N matrix with nothing reachable
+  explicit ReachabilityMatrix(int N)
+      : words(static_cast<std::size_t>(N) * ((N + 63) / 64), 0),
+        numVertices {N},
+        wordsPerRow {static_cast<std::size_t>(N + 63) / 64} {}
+
+  int size() const {
+    return numVertices;
+  }
+
+  bool empty() const {
+    return numVertices == 0;
+  }
+
+  // 64-bit words per row; bit t % 64 of word t / 64 is entry (s, t) and
+  // the bits past size() in the last word are always clear
+  std::size_t rowWords() const {
+    return wordsPerRow;
+  }
+
+  std::uint64_t* row(int s) {
+    return words.data() + static_cast<std::size_t>(s) * wordsPerRow;
+  }
+
+  const std::uint64_t* row(int s) const {
+    return words.data() + static_cast<std::size_t>(s) * wordsPerRow;
+  }
+
+  // is t reachable from s? every vertex reaches itself
+  bool reachable(int s, int t) const {
+    return (row(s)[t / 64] >> (t % 64)) & 1;
+  }
+
+  void set(int s, int t) {
+    row(s)[t / 64] |= std::uint64_t {1} << (t % 64);
+  }
+
+  // number of vertices reachable from s
+  int count(int s) const {
+    int total = 0;
+    for (std::size_t w = 0; w < wordsPerRow; ++w) {
+      total += __builtin_popcountll(row(s)[w]);
+    }
+    return total;
+  }
+
+  bool operator==(const ReachabilityMatrix& other) const = default;
+};
+
+// reachability read off a distance matrix: (s, t) is set wherever M(s, t)
+// is not infinity
+template <typename T>
+ReachabilityMatrix reachabilityOf(const DistanceMatrix<T>& M) {
+  ReachabilityMatrix R {M.size()};
+  for (int s = 0; s < M.size(); ++s) {
+    for (int t = 0; t < M.size(); ++t) {
+      if (M(s, t) != infinity<T>()) {
+        R.set(s, t);
+      }
+    }
+  }
+  return R;
+}
+
+// strongly connected components of G by an iterative Tarjan search.
+// component[v] numbers the components in the order they are completed,
+// which puts every component after all the components it has edges into;
+// returns the number of components
+template <typename T, typename Index>
+int stronglyConnectedComponents(const CSRGraph<T, Index>& G,
+                                std::pmr::vector<int>& component,
+                                std::pmr::memory_resource* scratch) {
+  const int V = G.size();
+  std::pmr::vector<int> index(V, -1, scratch);
+  std::pmr::vector<int> lowLink(V, 0, scratch);
+  std::pmr::vector<int> stack(scratch);
+  // (vertex, next out-edge to look at) for each open call
+  std::pmr::vector<std::pair<int, int> > calls(scratch);
+  component.assign(V, -1);
+  int nextIndex = 0;
+  int components = 0;
+  for (int root = 0; root < V; ++root) {
+    if (index[root] != -1) {
+      continue;
+    }
+    calls.push_back({root, G.offsets[root]});
+    index[root] = lowLink[root] = nextIndex++;
+    stack.push_back(root);
+    while (!calls.empty()) {
+      auto& [u, e] = calls.back();
+      if (e < G.offsets[u + 1]) {
+        int v = G.targets[e++];
+        if (index[v] == -1) {
+          index[v] = lowLink[v] = nextIndex++;
+          stack.push_back(v);
+          calls.push_back({v, G.offsets[v]});
+        } else if (component[v] == -1) {
+          // v is still on the stack
+          lowLink[u] = std::min(lowLink[u], index[v]);
+        }
+        continue;
+      }
+      int done = u;
+      calls.pop_back();
+      if (lowLink[done] == index[done]) {
+        int v = -1;
+        do {
+          v = stack.back();
+          stack.pop_back();
+          component[v] = components;
+        } while (v != done);
+        ++components;
+      }
+      if (!calls.empty()) {
+        int parent = calls.back().first;
+        lowLink[parent] = std::min(lowLink[parent], lowLink[done]);
+      }
+    }
+  }
+  return components;
+}
+
+// which vertices can each vertex of csr reach?
+template <typename T, typename Index>
+ReachabilityMatrix reachabilityMatrix(const CSRGraph<T, Index>& csr,
+                                      const APSPOptions& options) {
+  const int V = csr.size();
+  std::pmr::memory_resource* resource = options.resource;
+  std::pmr::vector<int> component(resource);
+  const int C = stronglyConnectedComponents(csr, component, resource);
+
+  // members of each component, in vertex order
+  std::pmr::vector<int> memberStart(C + 1, 0, resource);
+  std::pmr::vector<int> members(V, resource);
+  for (int v = 0; v < V; ++v) {
+    ++memberStart[component[v] + 1];
+  }
+  for (int c = 0; c < C; ++c) {
+    memberStart[c + 1] += memberStart[c];
+  }
+  {
+    std::pmr::vector<int> fill(memberStart.begin(), memberStart.end() - 1,
+                               resource);
+    for (int v = 0; v < V; ++v) {
+      members[fill[component[v]]++] = v;
+    }
+  }
+
+  // height of a component: 0 for a sink, else one more than the highest
+  // component it has an edge into. Successors come first in numbering
+  std::pmr::vector<int> height(C, 0, resource);
+  int maxHeight = 0;
+  for (int c = 0; c < C; ++c) {
+    for (int m = memberStart[c]; m < memberStart[c + 1]; ++m) {
+      int u = members[m];
+      for (int e = csr.offsets[u]; e < csr.offsets[u + 1]; ++e) {
+        int d = component[csr.targets[e]];
+        if (d != c) {
+          height[c] = std::max(height[c], height[d] + 1);
+        }
+      }
+    }
+    maxHeight = std::max(maxHeight, height[c]);
+  }
+  std::pmr::vector<int> levelStart(maxHeight + 2, 0, resource);
+  std::pmr::vector<int> byLevel(C, resource);
+  for (int c = 0; c < C; ++c) {
+    ++levelStart[height[c] + 1];
+  }
+  for (int h = 0; h <= maxHeight; ++h) {
+    levelStart[h + 1] += levelStart[h];
+  }
+  {
+    std::pmr::vector<int> fill(levelStart.begin(), levelStart.end() - 1,
+                               resource);
+    for (int c = 0; c < C; ++c) {
+      byLevel[fill[height[c]]++] = c;
+    }
+  }
+
+  ReachabilityMatrix R {V};
+  const std::size_t W = R.rowWords();
+  // the row of component c is kept in the row of its first member
+  auto buildRow = [&](int c, std::pmr::vector<int>& lastSeen) {
+    std::uint64_t* out = R.row(members[memberStart[c]]);
+    for (int m = memberStart[c]; m < memberStart[c + 1]; ++m) {
+      int u = members[m];
+      R.set(members[memberStart[c]], u);
+      for (int e = csr.offsets[u]; e < csr.offsets[u + 1]; ++e) {
+        int d = component[csr.targets[e]];
+        if (d == c or lastSeen[d] == c) {
+          continue;
+        }
+        lastSeen[d] = c;
+        const std::uint64_t* in = R.row(members[memberStart[d]]);
+        for (std::size_t w = 0; w < W; ++w) {
+          out[w] |= in[w];
+        }
+      }
+    }
+    for (int m = memberStart[c] + 1; m < memberStart[c + 1]; ++m) {
+      std::copy(out, out + W, R.row(members[m]));
+    }
+  };
+
+  unsigned workers = workerCount(options.numThreads, C);
+  int level = 0;
+  std::barrier sync {static_cast<std::ptrdiff_t>(workers),
+                     [&]() noexcept { ++level; }};
+  runWorkers(workers, [&](unsigned id) {
+    std::pmr::vector<int> lastSeen(C, -1, resource);
+    while (level <= maxHeight) {
+      long long count = levelStart[level + 1] - levelStart[level];
+      int first = levelStart[level] + static_cast<int>(count * id / workers);
+      int last =
+          levelStart[level] + static_cast<int>(count * (id + 1) / workers);
+      for (int i = first; i < last; ++i) {
+        buildRow(byLevel[i], lastSeen);
+      }
+      sync.arrive_and_wait();
+    }
+  });
+  return R;
+}
+
+// which vertices can each vertex of G reach?
+template <typename T>
+ReachabilityMatrix reachabilityMatrix(const Graph<T>& G,
+                                      const APSPOptions& options =
+                                          APSPOptions {}) {
+  return withVertexIndex(G.size(), [&](auto index) {
+    return reachabilityMatrix(
+        CSRGraph<T, decltype(index)> {G, options.resource}, options);
+  });
+}
+
+#endif      // REACHABILITY_HPP_
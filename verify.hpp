@@ -0,0 +1,200 @@
+#ifndef VERIFY_HPP_
+#define VERIFY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "graph.hpp"
+
+// Certificate check for an APSP result
+// M is accepted for G when, for every source s,
+//   - M(s, s) is 0,
+//   - every entry is finite or exactly infinity<T>(),
+//   - every edge (u, v, w) with M(s, u) finite has M(s, v) <= M(s, u) + w,
+//     so the true distance is an upper bound on M(s, v), which rules out
+//     entries that are too large (edgeNotRelaxed), and
+//   - every finite M(s, v) with v != s has a tight in-edge, one with
+//     M(s, u) + w == M(s, v), so M(s, v) is the length of some path, which
+//     rules out entries that are too small (noTightEdge).
+// The only wrong answer that passes is one sustained by a zero weight
+// cycle that s cannot reach. Comparisons allow an absolute tolerance
+// for floating point results summed in a different order.
+//
+// Sources are checked kVerifyLanes at a time: a block of rows is
+// transposed so the values of all its sources for one vertex are
+// contiguous, then each in-edge of the reverse CSR is one lane-wise
+// compare across the block. Blocks are spread across workers.
+
+enum class APSPDefect {
+  none,
+  wrongShape,
+  nonZeroDiagonal,
+  invalidEntry,
+  edgeNotRelaxed,
+  noTightEdge
+};
+
+struct APSPVerification {
+  APSPDefect defect = APSPDefect::none;
+  // the smallest source with a defect, and the vertex it was found at
+  int source = -1;
+  int vertex = -1;
+
+  explicit operator bool() const {
+    return defect == APSPDefect::none;
+  }
+};
+
+inline constexpr int kVerifyLanes = 16;
+
+// checks rows [first, first + count) of the matrix whose row s is row(s)
+template <typename T, typename RowAccess>
+APSPVerification verifyBlock(const CSRGraph<T>& reverse, RowAccess&& row,
+                             int first, int count, T tolerance,
+                             std::pmr::vector<T>& tile) {
+  constexpr int B = kVerifyLanes;
+  const int V = reverse.size();
+  const T inf = infinity<T>();
+  APSPDefect defect[B] {};
+  int defectVertex[B] {};
+  auto flag = [&](int b, APSPDefect what, int v) {
+    if (defect[b] == APSPDefect::none) {
+      defect[b] = what;
+      defectVertex[b] = v;
+    }
+  };
+
+  // unused lanes hold infinity, which satisfies every check
+  tile.assign(static_cast<std::size_t>(V) * B, inf);
+  for (int b = 0; b < count; ++b) {
+    const T* values = row(first + b);
+    for (int v = 0; v < V; ++v) {
+      T d = values[v];
+      if constexpr (std::is_floating_point_v<T>) {
+        if (d != inf and !std::isfinite(d)) {
+          flag(b, APSPDefect::invalidEntry, v);
+          d = inf;
+        }
+      }
+      tile[static_cast<std::size_t>(v) * B + b] = d;
+    }
+    if (values[first + b] != T {}) {
+      flag(b, APSPDefect::nonZeroDiagonal, first + b);
+    }
+  }
+
+  for (int v = 0; v < V; ++v) {
+    const T* dv = tile.data() + static_cast<std::size_t>(v) * B;
+    int tight[B] {};
+    int loose[B] {};
+    for (int e = reverse.offsets[v]; e < reverse.offsets[v + 1]; ++e) {
+      const T* du = tile.data() +
+                    static_cast<std::size_t>(reverse.targets[e]) * B;
+      T w = reverse.weights[e];
+      // branch-free so the lane loop vectorises
+      for (int b = 0; b < B; ++b) {
+        int reachedU = du[b] != inf;
+        int reachedV = dv[b] != inf;
+        // stands in for an unreachable u, where neither check applies
+        T viaU = reachedU ? du[b] + w : dv[b];
+        loose[b] |= reachedU & (dv[b] - tolerance > viaU);
+        tight[b] |= reachedU & reachedV & (viaU - tolerance <= dv[b]) &
+                    (dv[b] - tolerance <= viaU);
+      }
+    }
+    int bad = 0;
+    for (int b = 0; b < B; ++b) {
+      int needsTight = (dv[b] != inf) & (v != first + b);
+      bad |= loose[b] | (needsTight & !tight[b]);
+    }
+    if (bad) {
+      for (int b = 0; b < count; ++b) {
+        if (loose[b]) {
+          flag(b, APSPDefect::edgeNotRelaxed, v);
+        } else if (dv[b] != inf and v != first + b and !tight[b]) {
+          flag(b, APSPDefect::noTightEdge, v);
+        }
+      }
+    }
+  }
+
+  for (int b = 0; b < count; ++b) {
+    if (defect[b] != APSPDefect::none) {
+      return {defect[b], first + b, defectVertex[b]};
+    }
+  }
+  return {};
+}
+
+// checks V rows of the matrix whose row s is row(s)
+template <typename T, typename RowAccess>
+APSPVerification verifyRows(const Graph<T>& G, RowAccess&& row, T tolerance,
+                            const APSPOptions& options) {
+  const int V = G.size();
+  CSRGraph<T> reverse = transpose(CSRGraph<T> {G, options.resource},
+                                  options.resource);
+  const int blocks = (V + kVerifyLanes - 1) / kVerifyLanes;
+  std::vector<APSPVerification> found(blocks);
+  std::atomic<int> nextBlock {0};
+  // blocks after a failed one cannot hold the smallest failing source
+  std::atomic<int> firstFailure {blocks};
+  runWorkers(workerCount(options.numThreads, V), [&](unsigned) {
+    std::pmr::vector<T> tile(options.resource);
+    for (int block = nextBlock++; block < blocks; block = nextBlock++) {
+      if (block > firstFailure) {
+        continue;
+      }
+      int first = block * kVerifyLanes;
+      found[block] = verifyBlock(reverse, row, first,
+                                 std::min(kVerifyLanes, V - first),
+                                 tolerance, tile);
+      if (!found[block]) {
+        int seen = firstFailure;
+        while (block < seen and
+               !firstFailure.compare_exchange_weak(seen, block)) {
+        }
+      }
+    }
+  });
+  for (const APSPVerification& result : found) {
+    if (!result) {
+      return result;
+    }
+  }
+  return {};
+}
+
+// is M the distance matrix of G? see the top of this file for what is
+// checked
+template <typename T>
+APSPVerification verifyAPSP(const Graph<T>& G,
+                            const std::vector<std::vector<T> >& M,
+                            T tolerance = T {},
+                            const APSPOptions& options = APSPOptions {}) {
+  const int V = G.size();
+  if (static_cast<int>(M.size()) != V) {
+    return {APSPDefect::wrongShape, -1, -1};
+  }
+  for (int s = 0; s < V; ++s) {
+    if (static_cast<int>(M[s].size()) != V) {
+      return {APSPDefect::wrongShape, s, -1};
+    }
+  }
+  return verifyRows(G, [&M](int s) { return M[s].data(); }, tolerance,
+                    options);
+}
+
+template <typename T>
+APSPVerification verifyAPSP(const Graph<T>& G, const DistanceMatrix<T>& M,
+                            T tolerance = T {},
+                            const APSPOptions& options = APSPOptions {}) {
+  if (M.size() != G.size()) {
+    return {APSPDefect::wrongShape, -1, -1};
+  }
+  return verifyRows(G, [&M](int s) { return M.row(s); }, tolerance, options);
+}
+
+#endif      // VERIFY_HPP_
@@ -0,0 +1,247 @@
+#ifndef VERSIONED_HPP_
+#define VERSIONED_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "graph.hpp"
+
+// Versioned graph for concurrent readers and writers
+// Readers take an immutable GraphSnapshot and keep it for as long as they
+// like, for example for the whole of an APSP job; nothing they hold is
+// ever written again. Writers build the next version copy-on-write and
+// publish it by swapping one std::atomic<std::shared_ptr>, so readers
+// never see a half-applied update. That atomic is not lock-free in
+// libstdc++: a load or store holds a short internal lock, held only for
+// the reference count and pointer swap, never while a version is
+// built, so readers and a publishing writer can wait on each other only
+// for that long.
+//
+// A version is a two-level tree: a vector of pointers to chunks of
+// kSnapshotRowsPerChunk row pointers. An update copies the top vector,
+// the chunks it touches and the rows it touches; every other chunk and
+// row is shared with the previous version. A version is freed when the
+// last snapshot holding it is released.
+
+template <typename T>
+class VersionedGraph;
+
+inline constexpr int kSnapshotRowsPerChunk = 64;
+
+// one immutable version of a VersionedGraph; read-only mirror of Graph
+template <typename T>
+class GraphSnapshot {
+ public:
+  using AdjacencyMap = typename Graph<T>::AdjacencyMap;
+  using Chunk = std::array<std::shared_ptr<const AdjacencyMap>,
+                           kSnapshotRowsPerChunk>;
+
+ private:
+  // a null row has no edges
+  std::vector<std::shared_ptr<const Chunk> > chunks {};
+  int numVertices {};
+  std::size_t edgeCount {};
+  std::uint64_t versionNumber {};
+
+  friend class VersionedGraph<T>;
+
+  static const AdjacencyMap& emptyRow() {
+    static const AdjacencyMap empty {};
+    return empty;
+  }
+
+ public:
+  int size() const {
+    return numVertices;
+  }
+
+  std::size_t numEdges() const {
+    return edgeCount;
+  }
+
+  // 0 for the initial graph, then one more per published update
+  std::uint64_t version() const {
+    return versionNumber;
+  }
+
+  // out-edges of vertex a; throws std::out_of_range for an invalid vertex
+  const AdjacencyMap& neighbours(int a) const {
+    if (a < 0 or a >= numVertices) {
+      throw std::out_of_range("invalid vertex number");
+    }
+    const auto& row = (*chunks[a / kSnapshotRowsPerChunk])
+        [a % kSnapshotRowsPerChunk];
+    return row ? *row : emptyRow();
+  }
+
+  bool isEdge(int i, int j) const {
+    if (i >= 0 and i < numVertices and j >= 0 and j < numVertices) {
+      return neighbours(i).contains(j);
+    }
+    return false;
+  }
+
+  // will throw an exception if there is no edge from i to j
+  T getEdgeWeight(int i, int j) const {
+    return neighbours(i).at(j);
+  }
+};
+
+// mutable Graph with the same edges as a snapshot, for the APSP engines
+template <typename T>
+Graph<T> toGraph(const GraphSnapshot<T>& snapshot,
+                 std::pmr::memory_resource* resource =
+                     std::pmr::get_default_resource()) {
+  Graph<T> G {snapshot.size(), resource};
+  for (int u = 0; u < snapshot.size(); ++u) {
+    for (const auto& [v, weight] : snapshot.neighbours(u)) {
+      G.addEdge(u, v, weight);
+    }
+  }
+  return G;
+}
+
+template <typename T>
+class VersionedGraph {
+ public:
+  using Snapshot = GraphSnapshot<T>;
+  using AdjacencyMap = typename Snapshot::AdjacencyMap;
+  using Chunk = typename Snapshot::Chunk;
+
+  // the next version while an update is being applied; only the rows and
+  // chunks it has already copied are written
+  class Writer {
+   private:
+    Snapshot& draft;
+    std::pmr::memory_resource* resource;
+    std::unordered_map<int, Chunk*> ownChunks {};
+    std::unordered_map<int, AdjacencyMap*> ownRows {};
+
+    AdjacencyMap& mutableRow(int i) {
+      auto found = ownRows.find(i);
+      if (found != ownRows.end()) {
+        return *found->second;
+      }
+      int c = i / kSnapshotRowsPerChunk;
+      auto chunk = ownChunks.find(c);
+      if (chunk == ownChunks.end()) {
+        auto copy = std::make_shared<Chunk>(*draft.chunks[c]);
+        chunk = ownChunks.emplace(c, copy.get()).first;
+        draft.chunks[c] = std::move(copy);
+      }
+      auto& slot = (*chunk->second)[i % kSnapshotRowsPerChunk];
+      auto row = slot ? std::make_shared<AdjacencyMap>(*slot, resource)
+                      : std::make_shared<AdjacencyMap>(resource);
+      AdjacencyMap* raw = row.get();
+      slot = std::move(row);
+      ownRows.emplace(i, raw);
+      return *raw;
+    }
+
+   public:
+    Writer(Snapshot& draft, std::pmr::memory_resource* resource)
+        : draft {draft}, resource {resource} {}
+
+    // the draft as edited so far
+    const Snapshot& graph() const {
+      return draft;
+    }
+
+    // same semantics as Graph::addEdge: an existing edge keeps its weight
+    void addEdge(int i, int j, T weight) {
+      if (i < 0 or i >= draft.size() or j < 0 or j >= draft.size()) {
+        throw std::out_of_range("invalid vertex number");
+      }
+      if (!draft.isEdge(i, j)) {
+        mutableRow(i).insert({j, weight});
+        ++draft.edgeCount;
+      }
+    }
+
+    void removeEdge(int i, int j) {
+      if (draft.isEdge(i, j)) {
+        mutableRow(i).erase(j);
+        --draft.edgeCount;
+      }
+    }
+  };
+
+ private:
+  std::atomic<std::shared_ptr<const Snapshot> > current {};
+  // serialises writers; readers never take it
+  std::mutex writeMutex {};
+  std::pmr::memory_resource* rowResource;
+
+  // copy of the latest version with edit(writer) applied
+  template <typename Edit>
+  std::shared_ptr<Snapshot> edited(Edit&& edit) {
+    auto draft = std::make_shared<Snapshot>(*current.load());
+    Writer writer {*draft, rowResource};
+    edit(writer);
+    return draft;
+  }
+
+ public:
+  // N vertices and no edges
+  // rows are allocated from resource, which must be thread-safe because
+  // the last reader of a version frees it
+  explicit VersionedGraph(int N, std::pmr::memory_resource* resource =
+                                     std::pmr::get_default_resource())
+      : rowResource {resource} {
+    auto initial = std::make_shared<Snapshot>();
+    initial->numVertices = N;
+    int numChunks = (N + kSnapshotRowsPerChunk - 1) / kSnapshotRowsPerChunk;
+    // all chunks start out sharing one empty chunk
+    auto empty = std::make_shared<const Chunk>();
+    initial->chunks.assign(numChunks, empty);
+    current.store(std::move(initial));
+  }
+
+  // version 0 holds the edges of G
+  explicit VersionedGraph(const Graph<T>& G,
+                          std::pmr::memory_resource* resource =
+                              std::pmr::get_default_resource())
+      : VersionedGraph(G.size(), resource) {
+    current.store(edited([&G](Writer& writer) {
+      for (int u = 0; u < G.size(); ++u) {
+        for (const auto& [v, weight] : G.neighbours(u)) {
+          writer.addEdge(u, v, weight);
+        }
+      }
+    }));
+  }
+
+  // the latest published version; waits at most for a concurrent pointer
+  // swap, not for a writer building its version
+  std::shared_ptr<const Snapshot> snapshot() const {
+    return current.load(std::memory_order_acquire);
+  }
+
+  // applies edit(writer) to a copy of the latest version and publishes it
+  // as one new version, returning its number. If edit throws, nothing is
+  // published
+  template <typename Edit>
+  std::uint64_t update(Edit&& edit) {
+    std::lock_guard<std::mutex> lock {writeMutex};
+    std::shared_ptr<Snapshot> draft = edited(edit);
+    ++draft->versionNumber;
+    std::uint64_t published = draft->versionNumber;
+    current.store(std::move(draft), std::memory_order_release);
+    return published;
+  }
+
+  std::uint64_t addEdge(int i, int j, T weight) {
+    return update([&](Writer& writer) { writer.addEdge(i, j, weight); });
+  }
+
+  std::uint64_t removeEdge(int i, int j) {
+    return update([&](Writer& writer) { writer.removeEdge(i, j); });
+  }
+};
+
+#endif      // VERSIONED_HPP_